@@ -1,10 +1,21 @@
 #include <limits>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <new>
 #include <random>
 
+#if defined(__GLIBC__) || defined(_MSC_VER)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+
 #include <orderbook.hpp>
+#include <protocol.hpp>
 
 
 
@@ -14,6 +25,72 @@ static inline int64_t clamp_i64(int64_t x, int64_t lo, int64_t hi) {
     return x < lo ? lo : (x > hi ? hi : x);
 }
 
+// Heap accounting for `memory` mode. Every container in the book allocates through the global
+// operator new, so replacing it counts the map, list, orderIDs and trades allocations alike.
+// Sizes are the allocator's real block sizes, including its rounding.
+struct HeapCounter {
+    int64_t allocs = 0;
+    int64_t bytes = 0;      // Total bytes handed out
+    int64_t live = 0;       // Bytes currently allocated
+    int64_t arrays = 0;     // Part of live in blocks >= arrayBlock: orderIDs, trades, ladders
+    int64_t peak = 0;       // High-water mark of live
+};
+
+static constexpr int64_t arrayBlock = 4096; // Node allocations are far smaller
+
+static HeapCounter heap;
+static bool countHeap = false; // Off outside memory mode, so timings are unaffected
+
+static inline int64_t blockSize(void* p) {
+#if defined(__GLIBC__)
+    return (int64_t)malloc_usable_size(p);
+#elif defined(__APPLE__)
+    return (int64_t)malloc_size(p);
+#elif defined(_MSC_VER)
+    return (int64_t)_msize(p);
+#else
+    (void)p;
+    return 0;
+#endif
+}
+
+static void* countedAlloc(size_t n) {
+    void* p = malloc(n ? n : 1);
+    if (!p) throw bad_alloc();
+
+    if (countHeap) {
+        int64_t b = blockSize(p);
+        heap.allocs++;
+        heap.bytes += b;
+        heap.live += b;
+        if (b >= arrayBlock) heap.arrays += b;
+        if (heap.live > heap.peak) heap.peak = heap.live;
+    }
+    return p;
+}
+
+static void countedFree(void* p) noexcept {
+    if (p && countHeap) {
+        int64_t b = blockSize(p);
+        heap.live -= b;
+        if (b >= arrayBlock) heap.arrays -= b;
+    }
+    free(p);
+}
+
+void* operator new(size_t n) {return countedAlloc(n);}
+void* operator new[](size_t n) {return countedAlloc(n);}
+void operator delete(void* p) noexcept {countedFree(p);}
+void operator delete[](void* p) noexcept {countedFree(p);}
+void operator delete(void* p, size_t) noexcept {countedFree(p);}
+void operator delete[](void* p, size_t) noexcept {countedFree(p);}
+
+enum class Walk {
+    RANDOM,                           // unbiased steps of +-maxSpread
+    TRENDING,                         // random steps plus a constant drift
+    MEAN_REVERTING                    // random steps pulled back towards startMid
+};
+
 struct LoadConfig {
     int64_t ops = 1000000;          // how many actions
     double pLimit = 0.85;             // fraction limit orders
@@ -26,9 +103,12 @@ struct LoadConfig {
     int64_t warmup = 10000;          // ignore first N ops to generate liquidity
     int64_t checkEvery = 50000;      // run sanity checks every N ops
     uint64_t seed = 123456789;        // reproducible
+    Walk walk = Walk::RANDOM;         // mid price process
+    int64_t drift = 0;                // ticks added to mid every step when trending
 };
 
-static inline void cheapInvariants(OrderBook& ob) {
+template <class Book>
+static inline void cheapInvariants(Book& ob) {
     // minimal checks to catch obvious corruption
     price bid = ob.bestBid();
     price ask = ob.bestAsk();
@@ -41,8 +121,9 @@ static inline void cheapInvariants(OrderBook& ob) {
 
 }
 
+template <class Book = OrderBook>
 vector<Trade> massiveTestingAgent(const LoadConfig& cfg) {
-    OrderBook ob;
+    Book ob;
 
     std::mt19937_64 rng(cfg.seed);
     std::uniform_real_distribution<double> uni01(0.0, 1.0);
@@ -66,7 +147,11 @@ vector<Trade> massiveTestingAgent(const LoadConfig& cfg) {
         // crude “price process”: random walk on mid
         // (keeps book from drifting to infinity)
         if ((i % 1000) == 0) {
-            mid += spreadDist(rng);
+            switch (cfg.walk) {
+                case Walk::RANDOM: mid += spreadDist(rng); break;
+                case Walk::TRENDING: mid += cfg.drift + spreadDist(rng); break;
+                case Walk::MEAN_REVERTING: mid += spreadDist(rng) + (cfg.startMid - mid) / 4; break;
+            }
             mid = clamp_i64(mid, 1, std::numeric_limits<int64_t>::max() / 4);
         }
 
@@ -116,7 +201,398 @@ vector<Trade> massiveTestingAgent(const LoadConfig& cfg) {
     return ob.getTrades();
 }
 
-int main() {
+// Same flow through the std::map book and the hybrid ladder, on a fine-tick instrument whose
+// price wanders far further than any dense array could span.
+static void benchLevelStores() {
+    LoadConfig cfg;
+    cfg.ops = 3000000;
+    cfg.startMid = 3000000000;
+    cfg.maxSpread = 200;
+    cfg.maxQty = 10000;
+    cfg.checkEvery = 0;
+    cfg.seed = 8768698;
+
+    for (Walk walk : {Walk::TRENDING, Walk::MEAN_REVERTING}) {
+        cfg.walk = walk;
+        cfg.drift = 150;
+        string name = walk == Walk::TRENDING ? "trending" : "mean-reverting";
+
+        std::cout << "\n== " << name << " walk, map levels ==";
+        massiveTestingAgent<OrderBook>(cfg);
+        std::cout << "\n== " << name << " walk, hybrid levels ==";
+        massiveTestingAgent<HybridOrderBook>(cfg);
+    }
+}
+
+// Encodes the same kind of flow as massiveTestingAgent (plus cancels) into the binary protocol,
+// then times decode + match over the whole buffer.
+static void benchProtocol() {
+    const int64_t messages = 5000000;
+    std::mt19937_64 rng(8768698);
+    std::uniform_real_distribution<double> uni01(0.0, 1.0);
+    std::uniform_int_distribution<int32_t> qtyDist(1, 10000);
+    std::uniform_int_distribution<int64_t> spreadDist(-50, 50);
+
+    vector<char> stream;
+    stream.reserve(messages * 14);
+    int64_t mid = 10000;
+
+    for (int64_t i = 1; i <= messages; ++i) {
+        if ((i % 1000) == 0) mid = clamp_i64(mid + spreadDist(rng), 100, std::numeric_limits<int64_t>::max() / 4);
+
+        double r = uni01(rng);
+        bool isBuy = uni01(rng) < 0.5;
+        if (r < 0.75) encodeLimit(stream, qtyDist(rng), mid + spreadDist(rng), isBuy);
+        else if (r < 0.85) encodeMarket(stream, qtyDist(rng), isBuy);
+        else if (r < 0.95) encodeCancel(stream, (id)(uni01(rng) * i));
+        else encodeModify(stream, (id)(uni01(rng) * i), mid + spreadDist(rng), qtyDist(rng));
+    }
+
+    OrderBook ob;
+    DecodeStats stats;
+
+    auto t0 = chrono::steady_clock::now();
+    size_t used = decodeBuffer(stream.data(), stream.size(), ob, stats);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    std::cout << "messages: " << stats.messages << " (" << used << " bytes)\n"
+              << "rejected: " << stats.rejected << "\n"
+              << "trades stored: " << ob.getTrades().size() << "\n"
+              << "time(s): " << seconds << "\n"
+              << "throughput(msgs/s): " << stats.messages / seconds << "\n"
+              << "throughput(MB/s): " << used / seconds / 1e6 << "\n";
+
+    string binData = "data/example_orders.bin";
+    ofstream f(binData, ios::binary);
+    if (!f.is_open()) {
+        cerr << "Error opening file: " << binData << "\n";
+        return;
+    }
+    f.write(stream.data(), stream.size());
+}
+
+// Call phase with 1M resting orders on both sides of a common mid, then one uncross.
+template <class Book>
+static void benchAuction(const string& name) {
+    const int64_t numOrders = 1000000;
+    std::mt19937_64 rng(8768698);
+    std::uniform_int_distribution<int32_t> qtyDist(1, 10000);
+    std::uniform_int_distribution<int64_t> spreadDist(-50, 50);
+    std::uniform_int_distribution<int> sideDist(0, 1);
+
+    Book ob;
+    ob.startAuction();
+
+    using clock = chrono::steady_clock;
+    auto t0 = clock::now();
+    for (int64_t i = 0; i < numOrders; ++i) ob.placeLimit(qtyDist(rng), 10000 + spreadDist(rng), sideDist(rng) == 1);
+    auto t1 = clock::now();
+    auto [px, vol] = ob.indicative();
+    auto t2 = clock::now();
+    ob.uncross();
+    auto t3 = clock::now();
+
+    std::cout << "\n== auction, " << name << " levels ==\n"
+              << "orders: " << numOrders << "\n"
+              << "call phase(s): " << chrono::duration<double>(t1 - t0).count() << "\n"
+              << "indicative(us): " << chrono::duration<double, micro>(t2 - t1).count() << "\n"
+              << "uncross(s): " << chrono::duration<double>(t3 - t2).count() << "\n"
+              << "equilibrium: " << vol << " @ " << px << "\n"
+              << "trades stored: " << ob.getTrades().size() << "\n"
+              << "best bid/ask after: " << ob.bestBid() << " / " << ob.bestAsk() << "\n";
+}
+
+// Cost of moving the top of book with a growing number of resting pegs: each op places a
+// limit inside the spread (new best) and cancels it (best moves back).
+static void benchPegs() {
+    std::mt19937_64 rng(8768698);
+    std::uniform_int_distribution<int32_t> qtyDist(1, 10000);
+    std::uniform_int_distribution<int> sideDist(0, 1);
+    const int64_t moves = 1000000;
+
+    for (int64_t pegs : {0, 10000, 100000, 1000000}) {
+        OrderBook ob;
+        for (int64_t i = 0; i < 1000; ++i) {
+            ob.placeLimit(qtyDist(rng), 9000 + i % 500, true);
+            ob.placeLimit(qtyDist(rng), 11000 - i % 500, false);
+        }
+        // Midpoint pegs only on the buy side so they cannot cross each other
+        for (int64_t i = 0; i < pegs; ++i) {
+            bool isBuy = i % 2 == 0;
+            ob.placePeg(qtyDist(rng), isBuy, isBuy && i % 4 == 0 ? Peg::MIDPOINT : Peg::PRIMARY);
+        }
+
+        id next = 2000 + pegs;
+        auto t0 = chrono::steady_clock::now();
+        for (int64_t i = 0; i < moves; ++i) {
+            bool isBuy = sideDist(rng) == 1;
+            ob.placeLimit(qtyDist(rng), isBuy ? 9600 + i % 100 : 10400 - i % 100, isBuy);
+            ob.pegPrice(isBuy, Peg::MIDPOINT);
+            ob.cancelOrder(next);
+            next += 1;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+        std::cout << "resting pegs: " << pegs
+                  << "  top-of-book moves/s: " << 2 * moves / seconds
+                  << "  ns/move: " << seconds * 1e9 / (2 * moves) << "\n";
+    }
+
+    // Mixed flow where half of all new orders are pegged
+    std::uniform_real_distribution<double> uni01(0.0, 1.0);
+    std::uniform_int_distribution<int64_t> spreadDist(-50, 50);
+    OrderBook ob;
+    const int64_t ops = 3000000;
+    int64_t mid = 10000;
+
+    auto t0 = chrono::steady_clock::now();
+    for (int64_t i = 1; i <= ops; ++i) {
+        if ((i % 1000) == 0) mid = clamp_i64(mid + spreadDist(rng), 100, std::numeric_limits<int64_t>::max() / 4);
+
+        double r = uni01(rng);
+        bool isBuy = uni01(rng) < 0.5;
+        if (r < 0.5) ob.placePeg(qtyDist(rng), isBuy, uni01(rng) < 0.5 ? Peg::PRIMARY : Peg::MIDPOINT);
+        else if (r < 0.9) ob.placeLimit(qtyDist(rng), mid + spreadDist(rng), isBuy);
+        else ob.placeMarket(qtyDist(rng), isBuy);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    std::cout << "\n50% pegged flow\n"
+              << "ops: " << ops << "\n"
+              << "time(s): " << seconds << "\n"
+              << "throughput(ops/s): " << ops / seconds << "\n"
+              << "trades stored: " << ob.getTrades().size() << "\n";
+}
+
+// Sweeps through sell levels made of icebergs, against the same liquidity posted as many
+// small plain orders (the only way to hide size before icebergs).
+static void benchIcebergs() {
+    const int64_t levels = 100, perLevel = 100;
+    const qty total = 10000, peak = 100, sweep = 50000;
+
+    for (bool iceberg : {true, false}) {
+        OrderBook ob;
+        int64_t posted = 0;
+
+        for (int64_t l = 0; l < levels; ++l) {
+            for (int64_t k = 0; k < perLevel; ++k) {
+                if (iceberg) {
+                    ob.placeIceberg(total, peak, 10001 + l, false);
+                    posted++;
+                }
+                else {
+                    for (qty q = 0; q < total; q += peak) ob.placeLimit(peak, 10001 + l, false);
+                    posted += total / peak;
+                }
+            }
+        }
+
+        auto [buyLiquidity, sellLiquidity] = ob.liquidity();
+        int64_t sweeps = 0;
+
+        auto t0 = chrono::steady_clock::now();
+        while (ob.bestAsk() != -1) {
+            ob.placeMarket(sweep, true);
+            sweeps++;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        size_t fills = ob.getTrades().size();
+
+        std::cout << "\n== " << (iceberg ? "iceberg levels" : "plain order levels") << " ==\n"
+                  << "orders posted: " << posted << "\n"
+                  << "liquidity swept: " << sellLiquidity << " in " << sweeps << " sweeps\n"
+                  << "fills: " << fills << "\n"
+                  << "time(s): " << seconds << "\n"
+                  << "throughput(fills/s): " << fills / seconds << "\n"
+                  << "throughput(qty/s): " << sellLiquidity / seconds << "\n";
+    }
+}
+
+// Resident set size and its high-water mark in bytes, -1 where /proc is unavailable.
+static tuple<int64_t, int64_t> residentMemory() {
+    int64_t rss = -1, hwm = -1;
+#ifdef __linux__
+    ifstream f("/proc/self/status");
+    string line;
+    while (getline(f, line)) {
+        if (line.rfind("VmRSS:", 0) == 0) rss = stoll(line.substr(6)) * 1024;
+        else if (line.rfind("VmHWM:", 0) == 0) hwm = stoll(line.substr(6)) * 1024;
+    }
+#endif
+    return {rss, hwm};
+}
+
+// Hands freed memory back to the OS and restarts the resident high-water mark, so each book
+// is measured on its own.
+static void resetResident() {
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif
+#ifdef __linux__
+    ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+static string mb(int64_t bytes) {
+    if (bytes < 0) return "n/a";
+    char out[32];
+    snprintf(out, sizeof(out), "%.1f MB", bytes / (1024.0 * 1024.0));
+    return out;
+}
+
+// Runs `ops` calls of op and prints the allocations they made per call. Net live bytes are split
+// into nodes (list/map) and array growth, which arrives in doublings and is only meaningful
+// amortized over many operations.
+template <class F>
+static void measureOp(const string& label, int64_t ops, F&& op) {
+    HeapCounter before = heap;
+    for (int64_t i = 0; i < ops; ++i) op(i);
+    HeapCounter after = heap;
+
+    int64_t arrays = after.arrays - before.arrays;
+    printf("  %-24s allocs/op: %5.2f  heap bytes/op: %7.1f  net live bytes/op: nodes %6.1f, arrays %6.1f\n",
+           label.c_str(),
+           (double)(after.allocs - before.allocs) / ops,
+           (double)(after.bytes - before.bytes) / ops,
+           (double)(after.live - before.live - arrays) / ops,
+           (double)arrays / ops);
+}
+
+// Bytes the allocator hands out for one of each building block, measured through the hook.
+static void memoryLayout() {
+    auto cost = [](auto&& make) {
+        int64_t before = heap.live;
+        auto keep = make();
+        return heap.live - before;
+    };
+
+    int64_t node = cost([] {level l; l.push_back(Order {}); return l;});
+    int64_t mapLevel = cost([] {map<price, level> m; m[0]; return m;});
+    int64_t ladder = cost([] {return HybridLevels(false);});
+
+    std::cout << "== layout ==\n"
+              << "resting order (list node): " << node << " B, sizeof(Order) " << sizeof(Order) << "\n"
+              << "price level (map node): " << mapLevel << " B\n"
+              << "hybrid ladder per side: " << ladder << " B for " << HybridLevels::defaultWindow << " ticks\n"
+              << "Pointer slot: " << sizeof(Pointer) << " B, one per ID ever issued, amortized by vector growth\n"
+              << "stored Trade: " << sizeof(Trade) << " B, amortized by vector growth\n";
+}
+
+// Builds a resting book of numOrders, turns it over once, then measures each operation type.
+template <class Book>
+static void benchMemory(const string& name, int64_t numOrders) {
+    const int64_t levelsPerSide = 1000;
+    const int64_t opsPerType = 100000;
+    std::mt19937_64 rng(8768698);
+    std::uniform_int_distribution<int32_t> qtyDist(1, 10000);
+    std::uniform_int_distribution<int64_t> depthDist(0, levelsPerSide - 1);
+
+    resetResident();
+    heap.peak = heap.live;
+    int64_t startLive = heap.live;
+    int64_t startRss = get<0>(residentMemory());
+
+    auto ob = make_unique<Book>();
+    int64_t emptyBook = heap.live - startLive + (int64_t)sizeof(Book);
+
+    // Both sides around 10000, never crossing
+    auto bandPrice = [&](bool isBuy) {return isBuy ? 9999 - depthDist(rng) : 10001 + depthDist(rng);};
+    auto placeBand = [&](int64_t i) {ob->placeLimit(qtyDist(rng), bandPrice(i % 2 == 0), i % 2 == 0);};
+
+    auto t0 = chrono::steady_clock::now();
+    for (int64_t i = 0; i < numOrders; ++i) placeBand(i);
+    double buildSeconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    int64_t builtLive = heap.live - startLive;
+    int64_t builtRss = get<0>(residentMemory());
+
+    // Steady state: one full turnover, every new order replaces the oldest resting one
+    for (int64_t i = 0; i < numOrders; ++i) {
+        placeBand(i);
+        ob->cancelOrder(i);
+    }
+    int64_t steadyLive = heap.live - startLive;
+    int64_t steadyRss = get<0>(residentMemory());
+
+    std::cout << "\n== memory, " << name << " levels, " << numOrders << " orders ==\n"
+              << "empty book: " << emptyBook << " B\n"
+              << "build(s): " << buildSeconds << "\n"
+              << "after build: heap " << mb(builtLive) << ", resident " << mb(builtRss - startRss)
+              << ", " << (double)builtLive / numOrders << " B per live order\n"
+              << "steady state (" << 2 * numOrders << " IDs issued): heap " << mb(steadyLive)
+              << ", resident " << mb(steadyRss - startRss)
+              << ", " << (double)steadyLive / numOrders << " B per live order\n";
+
+    std::cout << "per operation (" << opsPerType << " each):\n";
+    id next = 2 * numOrders;
+
+    measureOp("limit, existing level", opsPerType, placeBand);
+    measureOp("cancel", opsPerType, [&](int64_t i) {ob->cancelOrder(next + i);});
+    next += opsPerType;
+
+    // Far above the band: every order opens its own level (sparse map for the hybrid)
+    measureOp("limit, new level", opsPerType, [&](int64_t i) {ob->placeLimit(qtyDist(rng), 20000 + i, false);});
+    measureOp("cancel, last at level", opsPerType, [&](int64_t i) {ob->cancelOrder(next + i);});
+    next += opsPerType;
+
+    // The turnover orders: ID numOrders + i was placed on the buy side when i is even
+    int64_t modifies = min(opsPerType, numOrders);
+    measureOp("modify", modifies, [&](int64_t i) {ob->modifyOrder(numOrders + i, bandPrice(i % 2 == 0), qtyDist(rng));});
+    measureOp("market, one fill", opsPerType, [&](int64_t i) {ob->placeMarket(1, i % 2 == 0);});
+    measureOp("peg", opsPerType, [&](int64_t i) {ob->placePeg(qtyDist(rng), i % 2 == 0, Peg::PRIMARY);});
+
+    auto [endRss, endHwm] = residentMemory();
+    std::cout << "peak: heap " << mb(heap.peak - startLive) << ", resident " << mb(endHwm - startRss) << "\n"
+              << "end: heap " << mb(heap.live - startLive) << ", resident " << mb(endRss - startRss)
+              << ", trades stored " << ob->getTrades().size() << "\n";
+}
+
+static void benchMemorySizes(const vector<int64_t>& sizes) {
+    countHeap = true;
+    memoryLayout();
+
+    for (int64_t n : sizes) {
+        benchMemory<OrderBook>("map", n);
+        benchMemory<HybridOrderBook>("hybrid", n);
+    }
+}
+
+int main(int argc, char** argv) {
+    string mode = argc > 1 ? argv[1] : "";
+
+    if (mode == "levels") {
+        benchLevelStores();
+        return 0;
+    }
+
+    if (mode == "protocol") {
+        benchProtocol();
+        return 0;
+    }
+
+    if (mode == "peg") {
+        benchPegs();
+        return 0;
+    }
+
+    if (mode == "iceberg") {
+        benchIcebergs();
+        return 0;
+    }
+
+    if (mode == "memory") {
+        vector<int64_t> sizes;
+        for (int i = 2; i < argc; ++i) sizes.push_back(stoll(argv[i]));
+        if (sizes.empty()) sizes = {10000, 100000, 1000000, 10000000};
+        benchMemorySizes(sizes);
+        return 0;
+    }
+
+    if (mode == "auction") {
+        benchAuction<OrderBook>("map");
+        benchAuction<HybridOrderBook>("hybrid");
+        return 0;
+    }
+
     LoadConfig cfg;
     cfg.ops = 3000000;
     cfg.pLimit = 0.8;
@@ -6,7 +6,7 @@ int main() {
     string command;
 
     cout << "Welcome to the Order Book Interface!" << endl;
-    cout << "Available commands: placeLimit, placeMarket, cancelOrder, modifyOrder, bestBid, bestAsk, volume, spread, size, numOrders, printBook, printTrades, clear, exit" << endl;
+    cout << "Available commands: placeLimit, placeIceberg, placeMarket, placePeg, pegPrice, cancelOrder, modifyOrder, bestBid, bestAsk, volume, executable, spread, size, liquidity, numOrders, printBook, printTrades, startAuction, indicative, uncross, clear, exit" << endl;
 
     while (true) {
         cout << "\nEnter command: ";
@@ -44,6 +44,37 @@ int main() {
             }
         } 
 
+        else if (command == "placeIceberg") {
+            qty quantity, peak;
+            price price;
+            side orderType;
+            cout << "Enter total quantity: ";
+            cin >> quantity;
+            cout << "Enter displayed quantity: ";
+            cin >> peak;
+            cout << "Enter price: ";
+            cin >> price;
+            cout << "Enter order type (0 for sell, 1 for buy): ";
+            cin >> orderType;
+
+            Status stat = ob.placeIceberg(quantity, peak, price, orderType);
+            if (stat != Status::OK && stat != Status::BOOK_EMPTY) {
+                cout << "Error placing iceberg order: ";
+                switch (stat) {
+                    case Status::INVALID_QTY:
+                        cout << "Invalid quantity or displayed quantity." << endl;
+                        break;
+                    case Status::INVALID_PRICE:
+                        cout << "Invalid price." << endl;
+                        break;
+                    default:
+                        cout << "Unknown error." << endl;
+                }
+            } else {
+                cout << "Iceberg order placed successfully." << endl;
+            }
+        }
+
         else if (command == "placeMarket") {
             qty quantity;
             side orderType;
@@ -59,6 +90,9 @@ int main() {
                     case Status::INVALID_QTY:
                         cout << "Invalid quantity." << endl;
                         break;
+                    case Status::INVALID_PHASE:
+                        cout << "Market orders are not accepted during an auction." << endl;
+                        break;
                     default:
                         cout << "Unknown error." << endl;
                 } 
@@ -66,6 +100,51 @@ int main() {
                 cout << "Market order placed successfully." << endl;
             }
         }
+        else if (command == "placePeg") {
+            qty quantity;
+            side orderType;
+            int peg;
+            cout << "Enter quantity: ";
+            cin >> quantity;
+            cout << "Enter order type (0 for sell, 1 for buy): ";
+            cin >> orderType;
+            cout << "Enter peg (1 for primary, 2 for midpoint): ";
+            cin >> peg;
+
+            Status stat = ob.placePeg(quantity, orderType, (Peg)peg);
+            if (stat != Status::OK && stat != Status::BOOK_EMPTY) {
+                cout << "Error placing pegged order: ";
+                switch (stat) {
+                    case Status::INVALID_QTY:
+                        cout << "Invalid quantity." << endl;
+                        break;
+                    case Status::INVALID_PRICE:
+                        cout << "Invalid peg." << endl;
+                        break;
+                    case Status::INVALID_PHASE:
+                        cout << "Pegged orders are not accepted during an auction." << endl;
+                        break;
+                    default:
+                        cout << "Unknown error." << endl;
+                }
+            } else {
+                cout << "Pegged order placed successfully." << endl;
+            }
+        }
+
+        else if (command == "pegPrice") {
+            side orderType;
+            int peg;
+            cout << "Enter order type (0 for sell, 1 for buy): ";
+            cin >> orderType;
+            cout << "Enter peg (1 for primary, 2 for midpoint): ";
+            cin >> peg;
+
+            price p = ob.pegPrice(orderType, (Peg)peg);
+            if (p == -1) cout << "Peg Price: N/A" << endl;
+            else cout << "Peg Price: " << p << endl;
+        }
+
         else if (command == "cancelOrder") {
             id orderID;
             cout << "Enter order ID to cancel: ";
@@ -143,6 +222,19 @@ int main() {
             cout << "Volume at price " << pricePoint << ": " << ob.volume(pricePoint) << endl;
         } 
 
+        else if (command == "executable") {
+            price pricePoint;
+            cout << "Enter price point: ";
+            cin >> pricePoint;
+            cout << "Executable quantity at price " << pricePoint << ": " << ob.executable(pricePoint) << endl;
+        }
+
+        else if (command == "liquidity") {
+            int64_t buyLiquidity, sellLiquidity;
+            tie(buyLiquidity, sellLiquidity) = ob.liquidity();
+            cout << "Buy Liquidity: " << buyLiquidity << ", Sell Liquidity: " << sellLiquidity << endl;
+        }
+
         else if (command == "spread") {
             price s = ob.spread();
             if (s == -1) cout << "Spread: N/A" << endl;
@@ -175,6 +267,23 @@ int main() {
             }
         }
         
+        else if (command == "startAuction") {
+            ob.startAuction();
+            cout << "Auction call phase started, orders will rest until uncross." << endl;
+        }
+
+        else if (command == "indicative") {
+            auto [px, vol] = ob.indicative();
+            if (px == -1) cout << "Indicative: N/A" << endl;
+            else cout << "Indicative Price: " << px << ", Volume: " << vol << endl;
+        }
+
+        else if (command == "uncross") {
+            size_t before = ob.getTrades().size();
+            if (ob.uncross() == Status::INVALID_PHASE) cout << "No auction in progress." << endl;
+            else cout << "Auction uncrossed, " << ob.getTrades().size() - before << " trades." << endl;
+        }
+
         else if (command == "exit") {
             cout << "Exiting Order Book Interface. Goodbye!" << endl;
             break;
@@ -0,0 +1,179 @@
+#include <protocol.hpp>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define HAVE_UNIX_SOCKETS 1
+#endif
+
+using namespace std;
+
+// Replays a binary order-entry stream (see protocol.hpp) into an OrderBook.
+//
+//   orderbook_feed orders.bin           file or named pipe
+//   orderbook_feed -                    stdin, e.g. `cat orders.bin | orderbook_feed -`
+//   orderbook_feed --socket /tmp/ob     Unix socket, serves one connection until EOF; the path
+//                                       must be free or a stale socket, and is removed afterwards
+//
+// Exits non-zero if the stream is malformed, ends inside a message or cannot be read.
+
+#ifdef HAVE_UNIX_SOCKETS
+// Socket path to remove if we are interrupted while it exists (async-signal-safe cleanup)
+static char socketPath[sizeof(sockaddr_un::sun_path)];
+
+static void removeSocket(int) {
+    unlink(socketPath);
+    _exit(1);
+}
+#endif
+
+static void usage() {
+    cerr << "usage: orderbook_feed <file | - | --socket path>" << endl;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+
+    string source = argv[1];
+    FILE* file = nullptr;
+    int fd = -1;
+
+    if (source == "--socket") {
+#ifdef HAVE_UNIX_SOCKETS
+        if (argc < 3) {
+            usage();
+            return 1;
+        }
+
+        sockaddr_un addr {};
+        addr.sun_family = AF_UNIX;
+        if (strlen(argv[2]) >= sizeof(addr.sun_path)) {
+            cerr << "Socket path too long: " << argv[2] << endl;
+            return 1;
+        }
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", argv[2]);
+
+        // Only ever replace a stale socket, never a file that happens to sit at the path
+        struct stat existing;
+        if (lstat(addr.sun_path, &existing) == 0) {
+            if (!S_ISSOCK(existing.st_mode)) {
+                cerr << "Refusing to replace " << argv[2] << ": not a socket." << endl;
+                return 1;
+            }
+            unlink(addr.sun_path);
+        }
+
+        int server = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (server < 0 || bind(server, (sockaddr*)&addr, sizeof(addr)) < 0) {
+            cerr << "Error opening socket: " << argv[2] << endl;
+            return 1;
+        }
+        memcpy(socketPath, addr.sun_path, sizeof(socketPath));
+        signal(SIGINT, removeSocket);
+        signal(SIGTERM, removeSocket);
+
+        if (listen(server, 1) < 0) {
+            cerr << "Error opening socket: " << argv[2] << endl;
+            unlink(addr.sun_path);
+            return 1;
+        }
+
+        cerr << "Waiting for a connection on " << argv[2] << endl;
+        fd = accept(server, nullptr, nullptr);
+        close(server);
+        unlink(addr.sun_path); // Serves one connection, so the path is done with either way
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        if (fd < 0) {
+            cerr << "Error accepting connection." << endl;
+            return 1;
+        }
+#else
+        cerr << "Unix sockets are not supported on this platform." << endl;
+        return 1;
+#endif
+    }
+    else {
+        file = source == "-" ? stdin : fopen(source.c_str(), "rb");
+        if (!file) {
+            cerr << "Error opening file: " << source << endl;
+            return 1;
+        }
+    }
+
+    // Returns 0 at EOF and on error; readError tells the two apart
+    bool readError = false;
+    auto readChunk = [&](char* dst, size_t n) -> size_t {
+#ifdef HAVE_UNIX_SOCKETS
+        if (fd >= 0) {
+            ssize_t got;
+            do got = read(fd, dst, n); while (got < 0 && errno == EINTR);
+            if (got < 0) {
+                cerr << "Error reading socket: " << strerror(errno) << endl;
+                readError = true;
+                return 0;
+            }
+            return (size_t)got;
+        }
+#endif
+        size_t got = fread(dst, 1, n, file);
+        if (got == 0 && ferror(file)) {
+            cerr << "Error reading " << source << endl;
+            readError = true;
+        }
+        return got;
+    };
+
+    OrderBook ob;
+    DecodeStats stats;
+    vector<char> buffer(1 << 16);
+    size_t filled = 0;
+
+    auto t0 = chrono::steady_clock::now();
+
+    while (true) {
+        size_t got = readChunk(buffer.data() + filled, buffer.size() - filled);
+        if (got == 0) break;
+        filled += got;
+
+        size_t used = decodeBuffer(buffer.data(), filled, ob, stats);
+        if (stats.malformed) {
+            cerr << "Malformed message at byte " << used << " of the current chunk, stopping." << endl;
+            break;
+        }
+
+        // Keep the partial message at the tail for the next read
+        filled -= used;
+        memmove(buffer.data(), buffer.data() + used, filled);
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    bool truncated = filled > 0 && !stats.malformed && !readError;
+    if (truncated) cerr << "Stream ended inside a message (" << filled << " bytes dropped)." << endl;
+
+#ifdef HAVE_UNIX_SOCKETS
+    if (fd >= 0) close(fd);
+#endif
+    if (file && file != stdin) fclose(file);
+
+    cout << "messages: " << stats.messages << "\n"
+         << "rejected: " << stats.rejected << "\n"
+         << "trades: " << ob.getTrades().size() << "\n"
+         << "best bid/ask: " << ob.bestBid() << " / " << ob.bestAsk() << "\n"
+         << "time(s): " << seconds << "\n"
+         << "throughput(msgs/s): " << stats.messages / seconds << "\n";
+
+    return stats.malformed || truncated || readError ? 1 : 0;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <types.hpp>
+#include <map>
+#include <vector>
+
+using namespace std;
+
+// Level stores hold one side of the book: the FIFO queue resting at each price.
+// best() is the lowest price on the sell side and the highest on the buy side (-1 if empty).
+
+class MapLevels {
+    public:
+
+    explicit MapLevels(side s) : orderType(s) {}
+
+    bool empty() const {return levels.empty();}
+    price best() const;
+    level& bestLevel();
+
+    level& operator[](price px) {return levels[px];} //O(log n)
+    level* find(price px);
+    const level* find(price px) const;
+    void erase(price px) {levels.erase(px);}
+    void clear() {levels.clear();}
+
+    template <class F> void forEach(F&& f) const { //Ascending price order
+        for (auto& [px, lvl] : levels) f(px, lvl);
+    }
+
+    private:
+
+    side orderType;
+    map<price, level> levels;
+};
+
+// Dense ladder of `window` ticks kept around the best price, with far-away levels overflowing
+// into a sorted sparse map. The ladder is a ring indexed by px & (window - 1), so moving the
+// window only migrates the levels that cross its edges. Levels are moved with list::splice,
+// which keeps the iterators held in Pointer valid.
+class HybridLevels {
+    public:
+
+    static constexpr price defaultWindow = 1024;
+
+    explicit HybridLevels(side s, price window = defaultWindow);
+
+    bool empty() const {return hot == 0 && far.empty();}
+    price best() const;
+    level& bestLevel();
+
+    level& operator[](price px);
+    level* find(price px);
+    const level* find(price px) const;
+    void erase(price px);
+    void clear();
+
+    template <class F> void forEach(F&& f) const { //Ascending price order
+        auto it = far.begin();
+        for (; it != far.end() && it->first < base; ++it) f(it->first, it->second);
+
+        size_t s = slot(base);
+        for (int64_t n = 0; n < hot; n++) {
+            s = scanUp(s);
+            f(priceOf(s), ladder[s]);
+            s = (s + 1) & mask;
+        }
+
+        for (; it != far.end(); ++it) f(it->first, it->second);
+    }
+
+    price window() const {return width;}
+
+    private:
+
+    side orderType;
+    price width;            // Ticks covered by the ladder, power of two >= 64
+    size_t mask;
+    price base = 0;         // Lowest price covered by the ladder, base + width never overflows
+    price top = -1;         // Best price on the ladder
+    int64_t hot = 0;        // Non-empty ladder slots
+    vector<level> ladder;
+    vector<uint64_t> bits;  // Occupancy bitmap of ladder slots
+    map<price, level> far;
+
+    bool inWindow(price px) const {return px >= base && px < base + width;}
+    size_t slot(price px) const {return (size_t)px & mask;}
+    price priceOf(size_t s) const {return base + (price)((s - slot(base)) & mask);}
+    bool occupied(size_t s) const {return (bits[s >> 6] >> (s & 63)) & 1;}
+    bool better(price a, price b) const {return orderType ? a > b : a < b;}
+    price room(price px) const {return orderType ? px - base : base + width - 1 - px;} //Ticks to the worse edge
+
+    size_t scanUp(size_t from) const;
+    size_t scanDown(size_t from) const;
+    price hotBest() const;
+    void recentre(price px);
+};
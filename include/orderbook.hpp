@@ -1,25 +1,55 @@
 #pragma once
 
 #include <types.hpp>
+#include <levels.hpp>
 #include <map>
+#include <array>
+#include <vector>
+#include <tuple>
+#include <chrono>
 
 using namespace std;
 using namespace std::chrono;
 
-class OrderBook {
+// Levels is the per-side price level store (see levels.hpp). Constructor arguments are
+// forwarded to both sides, e.g. HybridOrderBook ob(4096) for a 4096 tick ladder.
+template <class Levels>
+class BasicOrderBook {
     public: 
+
+    template <class... Args>
+    explicit BasicOrderBook(Args... args) : orders {Levels(false, args...), Levels(true, args...)} {}
     
     Status placeMarket(qty quantity, side orderType);
     Status placeLimit(qty quantity, price px, side orderType);
+    Status placeIceberg(qty quantity, qty peak, price px, side orderType); //Shows `peak` of `quantity` at a time
     Status cancelOrder(id orderID);
     Status modifyOrder(id orderID, price newPx, qty newQty);
 
+    // Pegged orders are hidden (not in bestBid/bestAsk, volume or getBook) and are priced from
+    // the lit book only when a match or pegPrice() needs them, so moving the top of book costs
+    // the same however many pegs are resting. modifyOrder keeps the peg and ignores newPx.
+    Status placePeg(qty quantity, side orderType, Peg peg);
+    price pegPrice(side orderType, Peg peg) const;
+
+    // Auctions: during the call phase limit orders rest without matching and market orders are
+    // rejected. uncross() executes everything that crosses at the equilibrium price in one batch
+    // and returns the book to continuous matching.
+    void startAuction();
+    Status uncross();
+    bool inAuction() const;
+    tuple<price, int64_t> indicative() const;
+
     price bestBid() const;
     price bestAsk() const;
     price spread() const;
 
+    // volume, size and getBook report displayed quantity; executable and liquidity add iceberg
+    // reserves (and, for liquidity, resting pegs).
     qty volume(price px) const;
+    int64_t executable(price px) const;
     tuple<qty, qty> size() const;
+    tuple<int64_t, int64_t> liquidity() const;
     tuple<int64_t, int64_t> numOrders() const;
 
     void clear();
@@ -32,12 +62,25 @@ class OrderBook {
     id orderId = -1;
     vector<Pointer> orderIDs;
     vector<Trade> trades;
-    array<map<price, level>, 2> orders;
+    array<Levels, 2> orders;
+    array<array<level, 2>, 2> pegged; //[side][PRIMARY, MIDPOINT] FIFO queues
 
-    map<price, level>& sell = orders[0];
-    map<price, level>& buy = orders[1];
+    bool auction = false;
+    array<map<price, int64_t>, 2> depth; //Aggregate quantity per level during the call phase
+    mutable bool indicativeStale = true;
+    mutable tuple<price, int64_t> indicativeCache {-1, 0};
+
+    Levels& sell = orders[0];
+    Levels& buy = orders[1];
 
     id getNewID();
     timestamp getTime();
-    Status matchOrders(side incomingType);
+    Status placeResting(qty quantity, price px, side orderType, qty peak);
+    void rest(id oid, qty quantity, price px, side orderType, qty peak);
+    void replenish(level& pLevel);
+    void matchPegs();
+    qty matchOrders(side incomingType, id incomingID, qty quantity, price limit);
 };
+
+using OrderBook = BasicOrderBook<MapLevels>;
+using HybridOrderBook = BasicOrderBook<HybridLevels>;
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <orderbook.hpp>
+#include <bit>
+#include <cstring>
+
+using namespace std;
+
+// Fixed-layout binary order entry, ITCH/OUCH style. Every message is a one byte type followed
+// by packed little-endian fields; lengths below include the type byte.
+//
+//  'L' limit    side u8, qty i32, price i64            14 bytes
+//  'M' market   side u8, qty i32                       6 bytes
+//  'X' cancel   id i64                                 9 bytes
+//  'U' modify   id i64, price i64, qty i32             21 bytes
+//  'P' peg      side u8, qty i32, peg u8               7 bytes   (peg: 1 primary, 2 midpoint)
+//  'I' iceberg  side u8, qty i32, peak i32, price i64  18 bytes
+//
+// Messages are decoded in place from the caller's buffer: fields are loaded straight into
+// registers and dispatched to the book, nothing is copied or allocated.
+
+static_assert(endian::native == endian::little, "protocol fields are read as host little-endian");
+
+enum class MsgType : char {
+    LIMIT = 'L',
+    MARKET = 'M',
+    CANCEL = 'X',
+    MODIFY = 'U',
+    PEG = 'P',
+    ICEBERG = 'I'
+};
+
+struct DecodeStats {
+    int64_t messages = 0;
+    int64_t rejected = 0;   // Book returned INVALID_* / ORDER_* for the message
+    bool malformed = false; // Stopped on an unknown message type
+};
+
+constexpr size_t msgLength(char type) {
+    switch ((MsgType)type) {
+        case MsgType::LIMIT: return 14;
+        case MsgType::MARKET: return 6;
+        case MsgType::CANCEL: return 9;
+        case MsgType::MODIFY: return 21;
+        case MsgType::PEG: return 7;
+        case MsgType::ICEBERG: return 18;
+    }
+    return 0;
+}
+
+template <class T> inline T load(const char* p) {
+    T v;
+    memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+template <class T> inline void store(vector<char>& out, T v) {
+    char bytes[sizeof(T)];
+    memcpy(bytes, &v, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+inline void encodeLimit(vector<char>& out, qty quantity, price px, side orderType) {
+    out.push_back((char)MsgType::LIMIT);
+    out.push_back((char)orderType);
+    store<qty>(out, quantity);
+    store<price>(out, px);
+}
+inline void encodeMarket(vector<char>& out, qty quantity, side orderType) {
+    out.push_back((char)MsgType::MARKET);
+    out.push_back((char)orderType);
+    store<qty>(out, quantity);
+}
+inline void encodeCancel(vector<char>& out, id orderID) {
+    out.push_back((char)MsgType::CANCEL);
+    store<id>(out, orderID);
+}
+inline void encodeModify(vector<char>& out, id orderID, price newPx, qty newQty) {
+    out.push_back((char)MsgType::MODIFY);
+    store<id>(out, orderID);
+    store<price>(out, newPx);
+    store<qty>(out, newQty);
+}
+inline void encodePeg(vector<char>& out, qty quantity, side orderType, Peg peg) {
+    out.push_back((char)MsgType::PEG);
+    out.push_back((char)orderType);
+    store<qty>(out, quantity);
+    out.push_back((char)peg);
+}
+inline void encodeIceberg(vector<char>& out, qty quantity, qty peak, price px, side orderType) {
+    out.push_back((char)MsgType::ICEBERG);
+    out.push_back((char)orderType);
+    store<qty>(out, quantity);
+    store<qty>(out, peak);
+    store<price>(out, px);
+}
+
+// Decodes the message at p and applies it to the book. Returns the bytes consumed, or 0 if
+// p holds only part of a message (or an unknown type, see msgLength).
+template <class Book>
+size_t decodeMessage(const char* p, size_t len, Book& ob, Status& st) {
+    if (len == 0) return 0;
+
+    size_t n = msgLength(p[0]);
+    if (n == 0 || len < n) return 0;
+
+    switch ((MsgType)p[0]) {
+        case MsgType::LIMIT:
+            st = ob.placeLimit(load<qty>(p + 2), load<price>(p + 6), p[1] != 0);
+            break;
+        case MsgType::MARKET:
+            st = ob.placeMarket(load<qty>(p + 2), p[1] != 0);
+            break;
+        case MsgType::CANCEL:
+            st = ob.cancelOrder(load<id>(p + 1));
+            break;
+        case MsgType::MODIFY:
+            st = ob.modifyOrder(load<id>(p + 1), load<price>(p + 9), load<qty>(p + 17));
+            break;
+        case MsgType::PEG:
+            st = ob.placePeg(load<qty>(p + 2), p[1] != 0, (Peg)p[6]);
+            break;
+        case MsgType::ICEBERG:
+            st = ob.placeIceberg(load<qty>(p + 2), load<qty>(p + 6), load<price>(p + 10), p[1] != 0);
+            break;
+    }
+    return n;
+}
+
+// Decodes every complete message in [data, data + len). Returns the bytes consumed; anything
+// left over is a partial message the caller should keep for the next read.
+template <class Book>
+size_t decodeBuffer(const char* data, size_t len, Book& ob, DecodeStats& stats) {
+    size_t pos = 0;
+
+    while (pos < len) {
+        Status st = Status::OK;
+        size_t n = decodeMessage(data + pos, len - pos, ob, st);
+        if (n == 0) {
+            if (msgLength(data[pos]) == 0) stats.malformed = true;
+            break;
+        }
+
+        stats.messages++;
+        switch (st) {
+            case Status::INVALID_QTY:
+            case Status::INVALID_PRICE:
+            case Status::ORDER_NOT_FOUND:
+            case Status::ORDER_INACTIVE:
+            case Status::INVALID_PHASE:
+                stats.rejected++;
+                break;
+            default: break;
+        }
+        pos += n;
+    }
+
+    return pos;
+}
@@ -1,4 +1,7 @@
+#pragma once
 
+
+#include <cstdint>
 #include <list>
 
 using namespace std;
@@ -11,8 +14,9 @@ using timestamp = int64_t;
 
 struct Order {
     id orderID;
-    qty quantity;
-    price price;
+    qty quantity;   // Displayed
+    qty reserve;    // Hidden iceberg reserve, 0 for plain orders
+    ::price price;
     timestamp ts;
 };
 
@@ -25,20 +29,29 @@ enum class Status {
     BOOK_EMPTY,
     PARTIAL_FILL,
     ORDER_NOT_FOUND,
-    ORDER_INACTIVE
+    ORDER_INACTIVE,
+    INVALID_PHASE
+};
+
+enum class Peg : uint8_t {
+    NONE,
+    PRIMARY,    // Follows the best price on its own side
+    MIDPOINT    // Follows the mid, rounded away from the opposite side
 };
 
 struct Trade {
     id sellerID;
     id buyerID;
-    price price;
+    ::price price;
     qty quantity;
     timestamp ts;
 };
 
 struct Pointer {
     side orderType;
-    price price;
+    ::price price;
     level::iterator iterator;
     bool active;
+    Peg peg;
+    qty peak;       // Iceberg display size, 0 for plain orders
 };
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include <levels.hpp>
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+price MapLevels::best() const { //O(1)
+    if (levels.empty()) return -1;
+    return orderType ? prev(levels.end())->first : levels.begin()->first;
+}
+level& MapLevels::bestLevel() { //O(1)
+    return orderType ? prev(levels.end())->second : levels.begin()->second;
+}
+level* MapLevels::find(price px) { //O(log n)
+    auto it = levels.find(px);
+    return it == levels.end() ? nullptr : &it->second;
+}
+const level* MapLevels::find(price px) const {
+    auto it = levels.find(px);
+    return it == levels.end() ? nullptr : &it->second;
+}
+
+HybridLevels::HybridLevels(side s, price window) : orderType(s) {
+    width = (price)bit_ceil((uint64_t)max<price>(window, 64));
+    mask = (size_t)width - 1;
+    ladder.resize(width);
+    bits.assign(width / 64, 0);
+}
+price HybridLevels::best() const { //O(1)
+    // Far levels better than the whole ladder win, otherwise the ladder holds the best price.
+    if (!far.empty()) {
+        price lo = far.begin()->first;
+        price hi = prev(far.end())->first;
+        if (!orderType && lo < base) return lo;
+        if (orderType && hi >= base + width) return hi;
+        if (hot == 0) return orderType ? hi : lo;
+    }
+    return top;
+}
+level& HybridLevels::bestLevel() {
+    price px = best();
+    if (inWindow(px) && occupied(slot(px))) return ladder[slot(px)];
+    return far.find(px)->second;
+}
+level& HybridLevels::operator[](price px) { //O(1) on the ladder, O(log n) in the sparse map
+    if (!inWindow(px)) {
+        // Follow the market: jump to a new best beyond the window, or re-centre on the best price
+        // once it has been pushed against the edge this order fell off. Anything else is far away.
+        price current = best();
+        if (current == -1 || hot == 0 || better(px, current)) recentre(px);
+        else if (!inWindow(current) || room(current) < width / 8) recentre(current);
+
+        if (!inWindow(px)) return far[px];
+    }
+
+    size_t s = slot(px);
+    if (!occupied(s)) {
+        bits[s >> 6] |= 1ULL << (s & 63);
+        if (hot == 0 || better(px, top)) top = px;
+        hot++;
+    }
+    return ladder[s];
+}
+level* HybridLevels::find(price px) {
+    if (inWindow(px)) return occupied(slot(px)) ? &ladder[slot(px)] : nullptr;
+    auto it = far.find(px);
+    return it == far.end() ? nullptr : &it->second;
+}
+const level* HybridLevels::find(price px) const {
+    if (inWindow(px)) return occupied(slot(px)) ? &ladder[slot(px)] : nullptr;
+    auto it = far.find(px);
+    return it == far.end() ? nullptr : &it->second;
+}
+void HybridLevels::erase(price px) {
+    if (!inWindow(px)) {far.erase(px); return;}
+
+    size_t s = slot(px);
+    if (!occupied(s)) return;
+
+    ladder[s].clear();
+    bits[s >> 6] &= ~(1ULL << (s & 63));
+    hot--;
+    if (px == top) top = hotBest();
+}
+void HybridLevels::clear() {
+    for (level& lvl : ladder) lvl.clear();
+    fill(bits.begin(), bits.end(), 0);
+    far.clear();
+    base = 0;
+    top = -1;
+    hot = 0;
+}
+size_t HybridLevels::scanUp(size_t from) const { //First occupied slot at or after `from` on the ring
+    size_t n = bits.size();
+    size_t w = from >> 6;
+    uint64_t word = bits[w] & (~0ULL << (from & 63));
+
+    for (size_t i = 0; i <= n; i++) {
+        if (word) return (w << 6) + countr_zero(word);
+        w = (w + 1) % n;
+        word = bits[w];
+    }
+    return from;
+}
+size_t HybridLevels::scanDown(size_t from) const { //Last occupied slot at or before `from` on the ring
+    size_t n = bits.size();
+    size_t w = from >> 6;
+    uint64_t word = bits[w] & (~0ULL >> (63 - (from & 63)));
+
+    for (size_t i = 0; i <= n; i++) {
+        if (word) return (w << 6) + 63 - countl_zero(word);
+        w = (w + n - 1) % n;
+        word = bits[w];
+    }
+    return from;
+}
+price HybridLevels::hotBest() const { //O(window / 64)
+    if (hot == 0) return -1;
+    return orderType ? priceOf(scanDown(slot(base + width - 1))) : priceOf(scanUp(slot(base)));
+}
+void HybridLevels::recentre(price px) { //O(window / 64 + migrated levels * log n)
+    // Keep base + width representable for prices near the top of the range
+    price newBase = clamp<price>(px - width / 2, 0, numeric_limits<price>::max() - width);
+
+    // Push ladder levels that fall outside the new window into the sparse map
+    for (size_t w = 0; w < bits.size(); w++) {
+        uint64_t word = bits[w];
+        while (word) {
+            size_t s = (w << 6) + countr_zero(word);
+            word &= word - 1;
+
+            price p = priceOf(s);
+            if (p >= newBase && p < newBase + width) continue;
+
+            level& dst = far[p];
+            dst.splice(dst.end(), ladder[s]);
+            bits[w] &= ~(1ULL << (s & 63));
+            hot--;
+        }
+    }
+
+    base = newBase;
+
+    // Pull sparse levels that now fall inside the window onto the ladder
+    auto it = far.lower_bound(base);
+    while (it != far.end() && it->first < base + width) {
+        size_t s = slot(it->first);
+        ladder[s].splice(ladder[s].end(), it->second);
+        bits[s >> 6] |= 1ULL << (s & 63);
+        hot++;
+        it = far.erase(it);
+    }
+
+    top = hotBest();
+}
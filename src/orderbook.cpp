@@ -1,48 +1,35 @@
 #include <orderbook.hpp>
 
-Status OrderBook::placeMarket(qty quantity, side orderType) {
+template <class Levels>
+Status BasicOrderBook<Levels>::placeMarket(qty quantity, side orderType) {
     if (quantity <= 0) {return Status::INVALID_QTY;}
+    if (auction) {return Status::INVALID_PHASE;}
 
     id oid = getNewID();
     if ((id)orderIDs.size() <= oid) orderIDs.resize(oid + 1);
-    orderIDs[oid] = Pointer {orderType, 0, level::iterator(), false};
+    orderIDs[oid] = Pointer {orderType, 0, level::iterator(), false, Peg::NONE, 0};
 
     auto& opp = orderType ? sell : buy; 
     if (opp.empty()) return Status::BOOK_EMPTY;
 
-    timestamp t = getTime();
-
-    while (quantity > 0 && !opp.empty()) { //O(n)
-
-        auto lvlIt = orderType? opp.begin() : prev(opp.end());
-        level& top = lvlIt->second;
-
-        Order& restingOrder = top.front();
-        qty traded = min(quantity, restingOrder.quantity);
-        
-        quantity -= traded;
-        restingOrder.quantity -= traded;
-
-        trades.push_back( Trade {
-            .buyerID = orderType? oid : restingOrder.orderID,
-            .sellerID = orderType? restingOrder.orderID : oid,
-            .price = restingOrder.price,
-            .quantity = traded,
-            .ts = t
-        });
-
-        if (restingOrder.quantity == 0) {
-            orderIDs[restingOrder.orderID].active = false;
-            top.pop_front();
-            if (top.empty()) opp.erase(lvlIt);
-        }
-    }
+    matchPegs();
+    quantity = matchOrders(orderType, oid, quantity, -1); //O(n)
 
     if (quantity > 0) return Status::PARTIAL_FILL;
     
     return Status::OK;
 }
-Status OrderBook::placeLimit(qty quantity, price px, side orderType) {
+template <class Levels>
+Status BasicOrderBook<Levels>::placeLimit(qty quantity, price px, side orderType) {
+    return placeResting(quantity, px, orderType, 0);
+}
+template <class Levels>
+Status BasicOrderBook<Levels>::placeIceberg(qty quantity, qty peak, price px, side orderType) {
+    if (peak <= 0 || peak > quantity) {return Status::INVALID_QTY;}
+    return placeResting(quantity, px, orderType, peak);
+}
+template <class Levels>
+Status BasicOrderBook<Levels>::placeResting(qty quantity, price px, side orderType, qty peak) {
 
     if (px <= 0) {return Status::INVALID_PRICE;}
     if (quantity <= 0) {return Status::INVALID_QTY;} //O(1)
@@ -50,51 +37,122 @@ Status OrderBook::placeLimit(qty quantity, price px, side orderType) {
     id oid = getNewID();
     if ((id)orderIDs.size() <= oid) orderIDs.resize(oid + 1); 
 
-    auto& pLevel = orders[orderType][px];
-    
-    pLevel.push_back( Order {
-        .orderID = oid,
-        .price = px,
-        .quantity = quantity,
-        .ts = getTime()
-    }); //O(log n) for map insertion, O(1) for list insertion
+    if (auction) {
+        rest(oid, quantity, px, orderType, peak);
+        depth[orderType][px] += quantity; //O(log n)
+        indicativeStale = true;
+        return Status::OK;
+    }
 
-    orderIDs[oid] = Pointer {orderType, px, prev(pLevel.end()), true}; //O(1) (contiguious array indexing instead of hashing)
+    matchPegs();
+    quantity = matchOrders(orderType, oid, quantity, px);
 
-    return matchOrders(orderType); //Use of function at the end might be inefficient.
+    if (quantity > 0) rest(oid, quantity, px, orderType, peak);
+    else orderIDs[oid] = Pointer {orderType, px, level::iterator(), false, Peg::NONE, peak};
+
+    return (buy.empty() || sell.empty()) ? Status::BOOK_EMPTY : Status::OK;
 }
-Status OrderBook::cancelOrder(id orderID) {
+template <class Levels>
+Status BasicOrderBook<Levels>::placePeg(qty quantity, side orderType, Peg peg) {
+    if (quantity <= 0) {return Status::INVALID_QTY;}
+    if (peg != Peg::PRIMARY && peg != Peg::MIDPOINT) {return Status::INVALID_PRICE;}
+    if (auction) {return Status::INVALID_PHASE;}
+
+    id oid = getNewID();
+    if ((id)orderIDs.size() <= oid) orderIDs.resize(oid + 1);
+
+    // Only an opposite midpoint peg can be marketable against a new peg
+    matchPegs();
+    price px = pegPrice(orderType, peg);
+    if (px != -1) quantity = matchOrders(orderType, oid, quantity, px);
+
+    if (quantity > 0) {
+        level& queue = pegged[orderType][(int)peg - 1];
+        queue.push_back( Order {
+            .orderID = oid,
+            .quantity = quantity,
+            .reserve = 0,
+            .price = 0,
+            .ts = getTime()
+        }); //O(1)
+        orderIDs[oid] = Pointer {orderType, 0, prev(queue.end()), true, peg, 0};
+    }
+    else orderIDs[oid] = Pointer {orderType, 0, level::iterator(), false, peg, 0};
+
+    return (buy.empty() || sell.empty()) ? Status::BOOK_EMPTY : Status::OK;
+}
+template <class Levels>
+price BasicOrderBook<Levels>::pegPrice(side orderType, Peg peg) const { //O(1)
+    price bid = bestBid();
+    price ask = bestAsk();
+
+    if (peg == Peg::PRIMARY) return orderType ? bid : ask;
+    if (peg != Peg::MIDPOINT || bid == -1 || ask == -1) return -1;
+
+    // Half the gap from the lower price, never (bid + ask) / 2, which overflows for large prices
+    price lo = min(bid, ask), hi = max(bid, ask);
+    return orderType ? lo + (hi - lo) / 2 : lo + (hi - lo + 1) / 2;
+}
+template <class Levels>
+Status BasicOrderBook<Levels>::cancelOrder(id orderID) {
     if (orderID < 0 || orderID >= (id)orderIDs.size()) {return Status::ORDER_NOT_FOUND;}
 
     Pointer& it = orderIDs[orderID]; 
 
     if (!it.active) {return Status::ORDER_INACTIVE;}
 
-    auto mapIt = orders[it.orderType].find(it.price);
-    if (mapIt == orders[it.orderType].end()) return Status::ORDER_NOT_FOUND;
-    auto& pLevel = mapIt->second;
+    if (it.peg != Peg::NONE) {
+        pegged[it.orderType][(int)it.peg - 1].erase(it.iterator); //O(1)
+        it.active = false;
+        return Status::OK;
+    }
+
+    level* pLevel = orders[it.orderType].find(it.price);
+    if (!pLevel) return Status::ORDER_NOT_FOUND;
 
-    pLevel.erase(it.iterator); //O(1)
-    if (pLevel.empty()) orders[it.orderType].erase(it.price); //O(1)
+    if (auction) {
+        auto d = depth[it.orderType].find(it.price);
+        d->second -= it.iterator->quantity + it.iterator->reserve;
+        if (d->second == 0) depth[it.orderType].erase(d);
+        indicativeStale = true;
+    }
+
+    pLevel->erase(it.iterator); //O(1)
+    if (pLevel->empty()) orders[it.orderType].erase(it.price); //O(1)
 
     it.active = false;
     return Status::OK;
 }
-Status OrderBook::modifyOrder(id orderID, price newPx, qty newQty) { //Maybe implement price changing without changing quantity priority selection.
+template <class Levels>
+Status BasicOrderBook<Levels>::modifyOrder(id orderID, price newPx, qty newQty) { //Maybe implement price changing without changing quantity priority selection.
+    if (orderID < 0 || orderID >= (id)orderIDs.size()) {return Status::ORDER_NOT_FOUND;}
+
     side s = orderIDs[orderID].orderType;
+    Peg peg = orderIDs[orderID].peg;
+    qty peak = orderIDs[orderID].peak;
+
+    // placePeg can reject the replacement, so check first: a rejected modify keeps the order
+    if (peg != Peg::NONE && orderIDs[orderID].active) {
+        if (newQty <= 0) {return Status::INVALID_QTY;}
+        if (auction) {return Status::INVALID_PHASE;}
+    }
+
     Status stat = cancelOrder(orderID);
     if (stat != Status::OK) {return stat;}
+    if (peg != Peg::NONE) return placePeg(newQty, s, peg);
+    if (peak > 0) return placeResting(newQty, newPx, s, min(peak, newQty));
     return placeLimit(newQty, newPx, s); //O(1)
 }
-price OrderBook::bestBid() const { //O(1)
-    if (buy.empty()) return -1; 
-    else return prev(buy.end()) -> first;
+template <class Levels>
+price BasicOrderBook<Levels>::bestBid() const { //O(1)
+    return buy.best();
 }
-price OrderBook::bestAsk() const { //O(1)
-    if (sell.empty()) return -1; 
-    return sell.begin() -> first;
+template <class Levels>
+price BasicOrderBook<Levels>::bestAsk() const { //O(1)
+    return sell.best();
 } 
-price OrderBook::spread() const { //O(1)
+template <class Levels>
+price BasicOrderBook<Levels>::spread() const { //O(1)
     price topBuy = bestBid();
     price topSell = bestAsk();
 
@@ -102,106 +160,351 @@ price OrderBook::spread() const { //O(1)
 
     return topSell - topBuy;
 } 
-qty OrderBook::volume(price px) const { //O(n)
+template <class Levels>
+qty BasicOrderBook<Levels>::volume(price px) const { //O(n)
     qty total = 0;
 
-    auto b = buy.find(px);
-    auto s = sell.find(px);
+    const level* b = buy.find(px);
+    const level* s = sell.find(px);
+
+    if (b) for (const Order& ord : *b) total += ord.quantity;
+    if (s) for (const Order& ord : *s) total += ord.quantity;
 
-    if (b != buy.end()) for (const Order& ord : b -> second) total += ord.quantity;
-    if (s != sell.end()) for (const Order& ord : s -> second) total += ord.quantity;
+    return total;
+}
+template <class Levels>
+int64_t BasicOrderBook<Levels>::executable(price px) const { //O(n)
+    int64_t total = 0;
+
+    const level* b = buy.find(px);
+    const level* s = sell.find(px);
+
+    if (b) for (const Order& ord : *b) total += ord.quantity + ord.reserve;
+    if (s) for (const Order& ord : *s) total += ord.quantity + ord.reserve;
 
     return total;
 }
-void OrderBook::clear() { //O(1)
+template <class Levels>
+void BasicOrderBook<Levels>::clear() { //O(1)
     orderId = -1;
     orderIDs.clear();
     buy.clear();
     sell.clear();
     trades.clear();
+    for (auto& queues : pegged) for (level& queue : queues) queue.clear();
+    auction = false;
+    depth[0].clear();
+    depth[1].clear();
+    indicativeStale = true;
 }
-tuple<qty, qty> OrderBook::size() const {
+template <class Levels>
+tuple<qty, qty> BasicOrderBook<Levels>::size() const {
     qty s, t;
     s = t = 0;
 
-    for (auto& [key, value] : buy ) { //O(n)
+    buy.forEach([&](price, const level& value) { //O(n)
         for (const Order& ord : value) s += ord.quantity;
-    }
+    });
 
-    for (auto& [key, value] : sell ) { //O(n)
+    sell.forEach([&](price, const level& value) { //O(n)
         for (const Order& ord : value) t += ord.quantity;
-    }
+    });
 
     return tuple<qty, qty> {s, t};
 }
-tuple<int64_t, int64_t> OrderBook::numOrders() const {
+template <class Levels>
+tuple<int64_t, int64_t> BasicOrderBook<Levels>::liquidity() const { //O(n)
+    int64_t total[2] = {0, 0};
+
+    for (int s = 0; s < 2; s++) {
+        orders[s].forEach([&](price, const level& value) {
+            for (const Order& ord : value) total[s] += ord.quantity + ord.reserve;
+        });
+        for (const level& queue : pegged[s]) {
+            for (const Order& ord : queue) total[s] += ord.quantity;
+        }
+    }
+
+    return tuple<int64_t, int64_t> {total[1], total[0]};
+}
+template <class Levels>
+tuple<int64_t, int64_t> BasicOrderBook<Levels>::numOrders() const {
     int s = 0;
 
-    for (auto& [key, value] : buy ) s += value.size(); //O(n)
+    buy.forEach([&](price, const level& value) {s += value.size();}); //O(n)
 
     return tuple<int64_t, int64_t> {s, orderId - s};
 }
-vector<Order> OrderBook::getBook() const {
+template <class Levels>
+vector<Order> BasicOrderBook<Levels>::getBook() const {
     vector<Order> book;
-    
-    for (auto& [key, value] : buy) {
-        for (const Order& order : value) book.push_back(order);
-    }
 
-    for (auto& [key, value] : sell) {
-        for (const Order& order : value) book.push_back(order);
-    }
+    // Displayed book only: iceberg reserves stay hidden
+    auto shown = [&](price, const level& value) {
+        for (const Order& order : value) {
+            book.push_back(order);
+            book.back().reserve = 0;
+        }
+    };
+    buy.forEach(shown);
+    sell.forEach(shown);
 
     return book;
 }
-vector<Trade> OrderBook::getTrades() const {return trades;}
+template <class Levels>
+vector<Trade> BasicOrderBook<Levels>::getTrades() const {return trades;}
 
-timestamp OrderBook::getTime() {
+template <class Levels>
+timestamp BasicOrderBook<Levels>::getTime() {
     return duration_cast<microseconds> (steady_clock::now().time_since_epoch()).count();
 }
-id OrderBook::getNewID() {
+template <class Levels>
+id BasicOrderBook<Levels>::getNewID() {
     orderId++; 
     return orderId;
 }
-Status OrderBook::matchOrders(side incomingType) {
+template <class Levels>
+void BasicOrderBook<Levels>::rest(id oid, qty quantity, price px, side orderType, qty peak) {
+    auto& pLevel = orders[orderType][px];
+    qty shown = peak > 0 ? min(peak, quantity) : quantity;
     
-    while (!buy.empty() && !sell.empty()) {
-        price bestBuy = bestBid();
-        price bestSell = bestAsk();
-        if (bestBuy < bestSell) return Status::OK;
-
-        Order& topBuy = buy[bestBuy].front();
-        Order& topSell = sell[bestSell].front();
+    pLevel.push_back( Order {
+        .orderID = oid,
+        .quantity = shown,
+        .reserve = quantity - shown,
+        .price = px,
+        .ts = getTime()
+    }); //O(log n) for map insertion, O(1) for list insertion
 
+    orderIDs[oid] = Pointer {orderType, px, prev(pLevel.end()), true, Peg::NONE, peak}; //O(1) (contiguious array indexing instead of hashing)
+}
+template <class Levels>
+void BasicOrderBook<Levels>::replenish(level& pLevel) { //O(1): same node and ID, next slice joins the back of the level
+    Order& ord = pLevel.front();
+    ord.quantity = min(orderIDs[ord.orderID].peak, ord.reserve);
+    ord.reserve -= ord.quantity;
+    ord.ts = getTime();
+    pLevel.splice(pLevel.end(), pLevel, pLevel.begin());
+}
+template <class Levels>
+void BasicOrderBook<Levels>::matchPegs() { //Resting midpoint pegs cross each other once the mid lands on a tick
+    level& bids = pegged[1][1];
+    level& asks = pegged[0][1];
+    timestamp t = -1;
+
+    while (!bids.empty() && !asks.empty()) {
+        price px = pegPrice(true, Peg::MIDPOINT);
+        if (px == -1 || px < pegPrice(false, Peg::MIDPOINT)) return;
+
+        if (t == -1) t = getTime();
+        Order& topBuy = bids.front();
+        Order& topSell = asks.front();
         qty quantity = min(topBuy.quantity, topSell.quantity);
 
-        Trade newTrade;
-        newTrade.buyerID = topBuy.orderID;
-        newTrade.sellerID = topSell.orderID;
-        newTrade.price = (incomingType)? bestSell : bestBuy;
-        newTrade.quantity = quantity;
-        newTrade.ts = getTime();
+        trades.push_back( Trade {
+            .sellerID = topSell.orderID,
+            .buyerID = topBuy.orderID,
+            .price = px,
+            .quantity = quantity,
+            .ts = t
+        });
 
-        trades.push_back(newTrade); //O(1)
-        
         topBuy.quantity -= quantity;
         topSell.quantity -= quantity;
 
         if (topBuy.quantity == 0) {
-
             orderIDs[topBuy.orderID].active = false;
-            buy[bestBuy].pop_front();
+            bids.pop_front();
         }
 
         if (topSell.quantity == 0) {
+            orderIDs[topSell.orderID].active = false;
+            asks.pop_front();
+        }
+    }
+}
+template <class Levels>
+qty BasicOrderBook<Levels>::matchOrders(side incomingType, id incomingID, qty quantity, price limit) { //limit -1 for market orders
+    auto& opp = incomingType ? sell : buy;
+    auto& queues = pegged[!incomingType];
+    timestamp t = -1;
+
+    // Pegs are priced once from the book as it stood before this order arrived and only
+    // reprice after it, like a venue repricing pegs after each event.
+    price pegPx[2] = {-1, -1};
+    for (int k = 0; k < 2; k++) {
+        if (!queues[k].empty()) pegPx[k] = pegPrice(!incomingType, (Peg)(k + 1));
+    }
+
+    while (quantity > 0) {
+        // Candidates are the lit top level and the front of each opposite peg queue. Better
+        // price wins; at the same price lit orders go first (pegs are hidden), then the older peg.
+        price topPx = opp.best();
+        level* source = topPx == -1 ? nullptr : &opp.bestLevel();
+        price px = topPx;
+        bool lit = true;
+
+        for (int k = 0; k < 2; k++) {
+            if (queues[k].empty() || pegPx[k] == -1) continue;
+
+            bool better = !source || (incomingType ? pegPx[k] < px : pegPx[k] > px);
+            bool older = pegPx[k] == px && !lit && queues[k].front().orderID < source->front().orderID;
+            if (better || older) {
+                source = &queues[k];
+                px = pegPx[k];
+                lit = false;
+            }
+        }
+
+        if (!source) break;
+        if (limit != -1 && (incomingType ? px > limit : px < limit)) break;
+
+        if (t == -1) t = getTime();
+        Order& restingOrder = source->front();
+        qty traded = min(quantity, restingOrder.quantity);
+        
+        quantity -= traded;
+        restingOrder.quantity -= traded;
+
+        trades.push_back( Trade {
+            .sellerID = incomingType? restingOrder.orderID : incomingID,
+            .buyerID = incomingType? incomingID : restingOrder.orderID,
+            .price = px,
+            .quantity = traded,
+            .ts = t
+        }); //O(1)
+
+        if (restingOrder.quantity == 0 && restingOrder.reserve > 0) replenish(*source);
+        else if (restingOrder.quantity == 0) {
+            orderIDs[restingOrder.orderID].active = false;
+            source->pop_front();
+            if (lit && source->empty()) opp.erase(topPx);
+        }
+    }
+
+    return quantity;
+}
+template <class Levels>
+void BasicOrderBook<Levels>::startAuction() { //O(n) once, then O(log n) per order
+    if (auction) return;
+    auction = true;
+    indicativeStale = true;
+
+    for (int s = 0; s < 2; s++) {
+        depth[s].clear();
+        orders[s].forEach([&](price px, const level& value) {
+            int64_t total = 0;
+            for (const Order& ord : value) total += ord.quantity + ord.reserve;
+            depth[s].emplace_hint(depth[s].end(), px, total);
+        });
+    }
+}
+template <class Levels>
+bool BasicOrderBook<Levels>::inAuction() const {return auction;}
+template <class Levels>
+tuple<price, int64_t> BasicOrderBook<Levels>::indicative() const { //O(levels), cached between changes
+    if (!auction) return {-1, 0};
+    if (!indicativeStale) return indicativeCache;
+
+    indicativeStale = false;
+    indicativeCache = {-1, 0};
+
+    const auto& bids = depth[1];
+    const auto& asks = depth[0];
+    if (bids.empty() || asks.empty()) return indicativeCache;
+
+    price lo = asks.begin()->first;
+    price hi = prev(bids.end())->first;
+    if (hi < lo) return indicativeCache;
+
+    // One ascending pass over every level price in [lo, hi]: sell volume at or below p
+    // only grows, buy volume at or above p only shrinks.
+    int64_t buyVol = 0;
+    auto b = bids.lower_bound(lo);
+    for (auto it = b; it != bids.end(); ++it) buyVol += it->second;
+    int64_t sellVol = 0;
+    auto a = asks.begin();
+
+    int64_t bestVol = 0, bestSurplus = 0;
+    price px = lo;
+    while (true) {
+        if (a != asks.end() && a->first == px) sellVol += (a++)->second;
+
+        int64_t vol = min(buyVol, sellVol);
+        int64_t surplus = buyVol > sellVol ? buyVol - sellVol : sellVol - buyVol;
+        if (vol > bestVol || (vol == bestVol && vol > 0 && surplus < bestSurplus)) { //Ties go to the lowest price
+            bestVol = vol;
+            bestSurplus = surplus;
+            indicativeCache = {px, vol};
+        }
+
+        if (b != bids.end() && b->first == px) buyVol -= (b++)->second;
+
+        // Next level price from whichever side still has one in range; no hi + 1 sentinel,
+        // which overflows when the best bid is INT64_MAX
+        bool asksLeft = a != asks.end() && a->first <= hi;
+        bool bidsLeft = b != bids.end(); // Every bid is at or below hi
+        if (!asksLeft && !bidsLeft) break;
+        px = !asksLeft ? b->first : !bidsLeft ? a->first : min(a->first, b->first);
+    }
+
+    return indicativeCache;
+}
+template <class Levels>
+Status BasicOrderBook<Levels>::uncross() { //O(executed orders), no matchOrders loop
+    if (!auction) return Status::INVALID_PHASE;
+
+    auto [px, remaining] = indicative();
+    auction = false;
+    depth[0].clear();
+    depth[1].clear();
+    indicativeStale = true;
+
+    if (remaining == 0) return (buy.empty() || sell.empty()) ? Status::BOOK_EMPTY : Status::OK;
 
+    // Every buy at or above px and sell at or below px is eligible; the equilibrium
+    // guarantees both sides hold at least `remaining` before running out.
+    timestamp t = getTime();
+
+    while (remaining > 0) {
+        price bidPx = buy.best();
+        price askPx = sell.best();
+        level& buyLevel = buy.bestLevel();
+        level& sellLevel = sell.bestLevel();
+        Order& topBuy = buyLevel.front();
+        Order& topSell = sellLevel.front();
+
+        qty quantity = (qty)min<int64_t>(remaining, min(topBuy.quantity, topSell.quantity));
+        remaining -= quantity;
+
+        trades.push_back( Trade {
+            .sellerID = topSell.orderID,
+            .buyerID = topBuy.orderID,
+            .price = px,
+            .quantity = quantity,
+            .ts = t
+        });
+
+        topBuy.quantity -= quantity;
+        topSell.quantity -= quantity;
+
+        if (topBuy.quantity == 0 && topBuy.reserve > 0) replenish(buyLevel);
+        else if (topBuy.quantity == 0) {
+            orderIDs[topBuy.orderID].active = false;
+            buyLevel.pop_front();
+            if (buyLevel.empty()) buy.erase(bidPx);
+        }
+
+        if (topSell.quantity == 0 && topSell.reserve > 0) replenish(sellLevel);
+        else if (topSell.quantity == 0) {
             orderIDs[topSell.orderID].active = false;
-            sell[bestSell].pop_front();
+            sellLevel.pop_front();
+            if (sellLevel.empty()) sell.erase(askPx);
         }
-                
-        if (buy[bestBuy].empty()) buy.erase(bestBuy);
-        if (sell[bestSell].empty()) sell.erase(bestSell);
     }
 
-    return Status::BOOK_EMPTY;
-}
\ No newline at end of file
+    return (buy.empty() || sell.empty()) ? Status::BOOK_EMPTY : Status::OK;
+}
+
+template class BasicOrderBook<MapLevels>;
+template class BasicOrderBook<HybridLevels>;
@@ -0,0 +1,278 @@
+#include "orderbook.hpp"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+
+// Differential harness: the same command stream runs through the reference book
+// (std::map levels) and every optimized backend, and the results must agree after
+// each step. Any byte string is a valid stream (8 bytes per command), so the same
+// entry point serves the seeded generator, libFuzzer and replay of saved failures.
+//
+//   orderbook_diff_test [seeds] [steps]     seeded run (CTest uses the defaults)
+//   orderbook_diff_test --replay file.bin   replay a saved stream
+//
+// Failing streams are minimized and written to differential_failure.bin, and printed
+// as a byte list that can be pasted into `regressions` below.
+
+using Bytes = vector<uint8_t>;
+
+static constexpr size_t commandSize = 8;
+
+// Streams that once made the backends diverge or crash.
+static const vector<Bytes> regressions = {
+    // modifyOrder on an ID that was never issued read past the end of orderIDs
+    {0x00, 0x00, 0x09, 0x10, 0x00, 0x00, 0x00, 0x00,
+     0x14, 0x00, 0x09, 0x10, 0x00, 0x00, 0x80, 0x00},
+    // Auction with a bid at INT64_MAX: indicative() overflowed past the top level and never returned
+    {0x1d, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+     0x00, 0x00, 0x04, 0x32, 0x00, 0x00, 0x00, 0x00,
+     0x00, 0x01, 0x04, 0x00, 0xf8, 0x00, 0x00, 0x00},
+};
+
+struct Snapshot {
+    Status status;
+    price bid, ask;
+    tuple<qty, qty> size;
+    tuple<int64_t, int64_t> liquidity;
+    bool auction;
+    tuple<price, int64_t> indicative;
+    price pegs[2][2];
+    vector<tuple<id, qty, int64_t, price>> book; // id, shown, executable at its price, price
+    vector<tuple<id, id, price, qty>> trades; // Trades since the previous step
+
+    bool operator==(const Snapshot&) const = default;
+};
+
+// Applies the command at p (commandSize bytes) to the book.
+template <class Book>
+static Status apply(Book& ob, const uint8_t* p, id step) {
+    side orderType = p[1] & 1;
+    Peg peg = (p[1] & 2) ? Peg::MIDPOINT : Peg::PRIMARY;
+    qty quantity = p[2] == 255 ? 0 : 1 + p[2] % 64;
+
+    // Mostly a tight band, sometimes far away to push levels off a hybrid ladder, and 1 in 16
+    // within 128 ticks of INT64_MAX or INT64_MAX / 2, where price arithmetic can overflow
+    uint16_t pxBits = p[3] | (p[4] << 8);
+    const price top = numeric_limits<price>::max();
+    price px;
+    if (pxBits == 0xffff) px = 0;
+    else if ((pxBits >> 12) == 0xf) px = ((pxBits & 0x800) ? top : top / 2 + 64) - (pxBits & 0x7f);
+    else if (pxBits & 0x8000) px = 1 + (pxBits & 0x7fff) * 37;
+    else px = 950 + pxBits % 100;
+
+    // Recent IDs, sometimes ones that do not exist (negative or not issued yet)
+    uint16_t idBits = p[5] | (p[6] << 8);
+    id orderID = (idBits & 0x8000) ? step + 5 : step - idBits % 40;
+
+    switch (p[0] % 32) {
+        case 12: case 13: case 14: case 15:
+            return ob.placeMarket(quantity, orderType);
+        case 16: case 17: case 18: case 19:
+            return ob.cancelOrder(orderID);
+        case 20: case 21: case 22:
+            return ob.modifyOrder(orderID, px, quantity);
+        case 23: case 24: case 25:
+            return ob.placePeg(quantity, orderType, peg);
+        case 26: case 27: case 28:
+            return ob.placeIceberg(quantity * 4, 1 + p[7] % (quantity + 1), px, orderType);
+        case 29:
+            ob.startAuction();
+            return Status::OK;
+        case 30:
+            return ob.uncross();
+        default:
+            return ob.placeLimit(quantity, px, orderType);
+    }
+}
+
+template <class Book>
+static Snapshot snapshot(const Book& ob, Status st, size_t& seenTrades) {
+    Snapshot snap {
+        .status = st,
+        .bid = ob.bestBid(),
+        .ask = ob.bestAsk(),
+        .size = ob.size(),
+        .liquidity = ob.liquidity(),
+        .auction = ob.inAuction(),
+        .indicative = ob.indicative(),
+        .pegs = {{ob.pegPrice(false, Peg::PRIMARY), ob.pegPrice(false, Peg::MIDPOINT)},
+                 {ob.pegPrice(true, Peg::PRIMARY), ob.pegPrice(true, Peg::MIDPOINT)}},
+        .book = {},
+        .trades = {}
+    };
+
+    // getBook hides iceberg reserves; executable() brings them back, once per level
+    price lastPx = -1;
+    int64_t depth = 0;
+    for (const Order& ord : ob.getBook()) {
+        if (ord.price != lastPx) {
+            lastPx = ord.price;
+            depth = ob.executable(lastPx);
+        }
+        snap.book.emplace_back(ord.orderID, ord.quantity, depth, ord.price);
+    }
+
+    vector<Trade> trades = ob.getTrades();
+    for (size_t i = seenTrades; i < trades.size(); i++) {
+        snap.trades.emplace_back(trades[i].buyerID, trades[i].sellerID, trades[i].price, trades[i].quantity);
+    }
+    seenTrades = trades.size();
+
+    return snap;
+}
+
+static string describe(const Snapshot& s) {
+    string out = "status=" + to_string((int)s.status)
+        + " bid=" + to_string(s.bid) + " ask=" + to_string(s.ask)
+        + " size=" + to_string(get<0>(s.size)) + "/" + to_string(get<1>(s.size))
+        + " liquidity=" + to_string(get<0>(s.liquidity)) + "/" + to_string(get<1>(s.liquidity))
+        + " auction=" + to_string(s.auction)
+        + " indicative=" + to_string(get<1>(s.indicative)) + "@" + to_string(get<0>(s.indicative))
+        + " orders=" + to_string(s.book.size()) + " newTrades=" + to_string(s.trades.size());
+    return out;
+}
+
+// Returns the index of the first command after which a backend disagrees with the
+// reference, or -1 if the whole stream agrees.
+static int64_t firstDivergence(const Bytes& input, string* why = nullptr) {
+    OrderBook reference;
+    HybridOrderBook hybrid;
+    HybridOrderBook narrow(64); // Tiny ladder: constant migration between the tiers
+
+    size_t seenRef = 0, seenHybrid = 0, seenNarrow = 0;
+    size_t commands = input.size() / commandSize;
+
+    for (size_t i = 0; i < commands; i++) {
+        const uint8_t* p = input.data() + i * commandSize;
+
+        Snapshot expected = snapshot(reference, apply(reference, p, (id)i), seenRef);
+        Snapshot gotHybrid = snapshot(hybrid, apply(hybrid, p, (id)i), seenHybrid);
+        Snapshot gotNarrow = snapshot(narrow, apply(narrow, p, (id)i), seenNarrow);
+
+        const char* backend = nullptr;
+        const Snapshot* got = nullptr;
+        if (!(gotHybrid == expected)) {backend = "hybrid"; got = &gotHybrid;}
+        else if (!(gotNarrow == expected)) {backend = "hybrid(64)"; got = &gotNarrow;}
+
+        // Continuous trading must never leave the lit book crossed
+        bool crossed = !expected.auction && expected.bid != -1 && expected.ask != -1 && expected.bid >= expected.ask;
+
+        if (backend || crossed) {
+            if (why) {
+                *why = crossed ? "reference book crossed: " + describe(expected)
+                               : string(backend) + " diverged\n  expected: " + describe(expected) + "\n  got:      " + describe(*got);
+            }
+            return (int64_t)i;
+        }
+    }
+
+    return -1;
+}
+
+// Drops whole commands while the stream still diverges (ddmin over command chunks).
+static Bytes minimize(Bytes input) {
+    int64_t step = firstDivergence(input);
+    input.resize((step + 1) * commandSize);
+
+    size_t chunk = input.size() / commandSize / 2;
+    while (chunk >= 1) {
+        bool removed = false;
+
+        for (size_t start = 0; start * commandSize < input.size(); ) {
+            Bytes candidate(input.begin(), input.begin() + start * commandSize);
+            size_t end = min(input.size(), (start + chunk) * commandSize);
+            candidate.insert(candidate.end(), input.begin() + end, input.end());
+
+            if (!candidate.empty() && firstDivergence(candidate) != -1) {
+                input = candidate;
+                removed = true;
+            }
+            else start += chunk;
+        }
+
+        if (!removed) chunk /= 2;
+    }
+
+    return input;
+}
+
+static void report(const Bytes& input) {
+    Bytes small = minimize(input);
+    string why;
+    int64_t step = firstDivergence(small, &why);
+
+    cerr << "Divergence at command " << step << " of a minimized stream of " << small.size() / commandSize << ":\n"
+         << why << "\nRegression case:\n    {";
+    for (size_t i = 0; i < small.size(); i++) {
+        char hex[8];
+        snprintf(hex, sizeof(hex), "0x%02x", small[i]);
+        cerr << (i == 0 ? "" : i % commandSize ? ", " : ",\n     ") << hex;
+    }
+    cerr << "},\n";
+
+    ofstream f("differential_failure.bin", ios::binary);
+    f.write((const char*)small.data(), small.size());
+    cerr << "Saved to differential_failure.bin" << endl;
+}
+
+#ifdef ORDERBOOK_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    Bytes input(data, data + size - size % commandSize);
+    if (firstDivergence(input) != -1) {
+        report(input);
+        abort();
+    }
+    return 0;
+}
+
+#else
+
+int main(int argc, char** argv) {
+    if (argc == 3 && string(argv[1]) == "--replay") {
+        ifstream f(argv[2], ios::binary);
+        Bytes input((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+        input.resize(input.size() - input.size() % commandSize);
+
+        string why;
+        int64_t step = firstDivergence(input, &why);
+        if (step == -1) {
+            cout << "Replay of " << input.size() / commandSize << " commands agrees." << endl;
+            return 0;
+        }
+        cerr << "Divergence at command " << step << ":\n" << why << endl;
+        return 1;
+    }
+
+    int seeds = argc > 1 ? stoi(argv[1]) : 200;
+    int steps = argc > 2 ? stoi(argv[2]) : 2000;
+
+    for (size_t r = 0; r < regressions.size(); r++) {
+        if (firstDivergence(regressions[r]) != -1) {
+            cerr << "Regression case " << r << " fails." << endl;
+            report(regressions[r]);
+            return 1;
+        }
+    }
+
+    for (int seed = 0; seed < seeds; seed++) {
+        std::mt19937_64 rng(seed);
+        Bytes input(steps * commandSize);
+        for (uint8_t& b : input) b = (uint8_t)rng();
+
+        if (firstDivergence(input) != -1) {
+            cerr << "Seed " << seed << " diverges." << endl;
+            report(input);
+            return 1;
+        }
+    }
+
+    std::cout << "Differential tests passed (" << regressions.size() << " regressions, "
+              << seeds << " seeds x " << steps << " commands).\n";
+    return 0;
+}
+
+#endif
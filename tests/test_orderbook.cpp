@@ -1,12 +1,15 @@
 
 #include "orderbook.hpp" 
+#include "protocol.hpp"
 #include <cassert>
 #include <iostream>
+#include <limits>
 #include <random>
 #include <tuple>
 
 // Helper: basic invariants you can check via public API
-static void check_invariants(const OrderBook& ob) {
+template <class Book>
+static void check_invariants(const Book& ob) {
     price bid = ob.bestBid();
     price ask = ob.bestAsk();
 
@@ -40,9 +43,9 @@ static void test_empty_book() {
 static void test_simple_cross_trade() {
     OrderBook ob;
 
-    // First order is ID 0 (buy), second is ID 1 (sell)
-    assert(ob.placeLimit(10, 100, true) == Status::OK);   // buy 10 @100
-    assert(ob.placeLimit(10, 99,  false) == Status::OK);  // sell 10 @99 crosses
+    // First order is ID 0 (buy), second is ID 1 (sell). BOOK_EMPTY: a side is empty afterwards
+    assert(ob.placeLimit(10, 100, true) == Status::BOOK_EMPTY);   // buy 10 @100
+    assert(ob.placeLimit(10, 99,  false) == Status::BOOK_EMPTY);  // sell 10 @99 crosses, both sides empty
 
     auto trades = ob.getTrades();
     assert(!trades.empty());
@@ -62,9 +65,9 @@ static void test_fifo_at_same_price() {
     OrderBook ob;
 
     // IDs: 0,1 are buys at same price; ID 2 is the sell that crosses
-    assert(ob.placeLimit(5, 100, true) == Status::OK);  // buy id 0
-    assert(ob.placeLimit(5, 100, true) == Status::OK);  // buy id 1
-    assert(ob.placeLimit(7, 100, false) == Status::OK); // sell id 2 crosses
+    assert(ob.placeLimit(5, 100, true) == Status::BOOK_EMPTY);  // buy id 0
+    assert(ob.placeLimit(5, 100, true) == Status::BOOK_EMPTY);  // buy id 1
+    assert(ob.placeLimit(7, 100, false) == Status::BOOK_EMPTY); // sell id 2 crosses, no sells left
 
     auto trades = ob.getTrades();
     // Should fill id0 fully (5), then id1 partially (2)
@@ -86,8 +89,8 @@ static void test_fifo_at_same_price() {
 static void test_cancel_and_inactive() {
     OrderBook ob;
 
-    // Place a limit -> id 0
-    assert(ob.placeLimit(10, 101, true) == Status::OK);
+    // Place a limit -> id 0 (no sells, so BOOK_EMPTY)
+    assert(ob.placeLimit(10, 101, true) == Status::BOOK_EMPTY);
 
     // Cancel works
     assert(ob.cancelOrder(0) == Status::OK);
@@ -105,10 +108,10 @@ static void test_modify_order_basic() {
     OrderBook ob;
 
     // Place buy id 0
-    assert(ob.placeLimit(10, 100, true) == Status::OK);
+    assert(ob.placeLimit(10, 100, true) == Status::BOOK_EMPTY);
 
-    // Modify will cancel then re-place a NEW order (new ID)
-    assert(ob.modifyOrder(0, 10, 105) == Status::OK);
+    // Modify will cancel then re-place a NEW order (new ID): modifyOrder(id, newPx, newQty)
+    assert(ob.modifyOrder(0, 105, 10) == Status::BOOK_EMPTY);
 
     // Old order is inactive, so cancel should say inactive now
     assert(ob.cancelOrder(0) == Status::ORDER_INACTIVE);
@@ -119,6 +122,346 @@ static void test_modify_order_basic() {
     check_invariants(ob);
 }
 
+// Hybrid ladder: levels far outside the window live in the sparse map and migrate
+// onto the ladder as the best price moves towards them.
+static void test_hybrid_levels_migrate() {
+    HybridOrderBook ob(64);
+
+    ob.placeLimit(10, 1000, false);       // sell id 0
+    ob.placeLimit(10, 1000000, false);    // sell id 1, far away
+    ob.placeLimit(5, 500, true);          // buy id 2
+    assert(ob.bestAsk() == 1000);
+    assert(ob.bestBid() == 500);
+
+    ob.placeMarket(10, true);             // clears 1000, best ask is now in the sparse map
+    assert(ob.bestAsk() == 1000000);
+
+    ob.placeLimit(4, 1000010, false);     // sell id 4 lands next to the far level
+    ob.placeLimit(4, 1000000, false);     // sell id 5 queues behind id 1
+    assert(ob.volume(1000000) == 14);
+
+    ob.placeMarket(12, true);             // id 1 fully, then id 5 partially (FIFO kept across migration)
+    auto trades = ob.getTrades();
+    assert(trades[trades.size() - 2].sellerID == 1);
+    assert(trades.back().sellerID == 5);
+    assert(trades.back().quantity == 2);
+
+    Status st = ob.cancelOrder(4);
+    assert(st == Status::OK);
+    (void)st;
+    assert(ob.bestAsk() == 1000000);
+    assert(ob.volume(1000000) == 2);
+
+    check_invariants(ob);
+}
+
+// Prices within a window of INT64_MAX: the ladder must stop short of the top of the range.
+static void test_hybrid_levels_extreme_prices() {
+    const price top = numeric_limits<price>::max();
+    HybridOrderBook ob;
+
+    assert(ob.placeLimit(1, top - 100, false) == Status::BOOK_EMPTY);  // sell id 0
+    assert(ob.placeLimit(1, top, false) == Status::BOOK_EMPTY);        // sell id 1
+    assert(ob.placeLimit(2, top - 101, true) == Status::OK);           // buy id 2
+    assert(ob.bestBid() == top - 101);
+    assert(ob.bestAsk() == top - 100);
+
+    assert(ob.placeLimit(3, top - 100, true) == Status::OK);           // buy id 3 takes id 0
+    assert(ob.getTrades().size() == 1);
+    assert(ob.bestBid() == top - 100);
+    assert(ob.bestAsk() == top);
+
+    check_invariants(ob);
+}
+
+// Binary protocol: messages split across reads are picked up once complete,
+// unknown types stop the decoder.
+static void test_protocol_decode() {
+    vector<char> stream;
+    encodeLimit(stream, 10, 100, true);     // buy id 0
+    encodeLimit(stream, 4, 100, false);     // sell id 1 crosses
+    encodeCancel(stream, 0);
+    encodeCancel(stream, 0);                // already inactive -> rejected
+    encodeModify(stream, 7, 100, 5);        // unknown id -> rejected
+    encodeMarket(stream, 3, true);          // book is empty on the sell side
+    assert(stream.size() == 14 + 14 + 9 + 9 + 21 + 6);
+
+    OrderBook ob;
+    DecodeStats stats;
+
+    size_t used = decodeBuffer(stream.data(), 20, ob, stats);  // second message is cut
+    assert(used == 14);
+    used += decodeBuffer(stream.data() + used, stream.size() - used, ob, stats);
+    assert(used == stream.size());
+    assert(stats.messages == 6);
+    assert(stats.rejected == 2);
+    assert(!stats.malformed);
+
+    auto trades = ob.getTrades();
+    assert(trades.size() == 1);
+    assert(trades[0].buyerID == 0 && trades[0].sellerID == 1 && trades[0].quantity == 4);
+    assert(ob.bestBid() == -1);
+
+    char junk[] = {'Z', 0, 0};
+    used = decodeBuffer(junk, sizeof(junk), ob, stats);
+    assert(used == 0);
+    assert(stats.malformed);
+
+    check_invariants(ob);
+}
+
+// Call phase: nothing matches, indicative follows every change, uncross executes
+// everything at the max-volume price.
+static void test_auction_uncross() {
+    OrderBook ob;
+    ob.startAuction();
+
+    ob.placeLimit(10, 102, true);   // buy id 0
+    ob.placeLimit(5, 101, true);    // buy id 1
+    ob.placeLimit(10, 99, true);    // buy id 2
+    ob.placeLimit(8, 98, false);    // sell id 3
+    ob.placeLimit(6, 100, false);   // sell id 4
+    ob.placeLimit(10, 103, false);  // sell id 5
+    assert(ob.getTrades().empty());
+    assert(ob.indicative() == make_tuple(price(100), int64_t(14)));
+
+    Status st = ob.placeMarket(5, true);
+    assert(st == Status::INVALID_PHASE);
+
+    st = ob.cancelOrder(4);
+    assert(st == Status::OK);
+    assert(ob.indicative() == make_tuple(price(102), int64_t(8)));
+
+    ob.placeLimit(6, 100, false);   // sell id 6 (the rejected market order took no id)
+    assert(ob.indicative() == make_tuple(price(100), int64_t(14)));
+
+    st = ob.uncross();
+    assert(st == Status::OK);
+    assert(!ob.inAuction());
+    (void)st;
+
+    auto trades = ob.getTrades();
+    assert(trades.size() == 3);
+    for ([[maybe_unused]] const Trade& t : trades) assert(t.price == 100);
+    assert(trades[0].buyerID == 0 && trades[0].sellerID == 3 && trades[0].quantity == 8);
+    assert(trades[1].buyerID == 0 && trades[1].sellerID == 6 && trades[1].quantity == 2);
+    assert(trades[2].buyerID == 1 && trades[2].sellerID == 6 && trades[2].quantity == 4);
+
+    assert(ob.bestBid() == 101);
+    assert(ob.bestAsk() == 103);
+    assert(ob.volume(101) == 1);
+    check_invariants(ob);
+
+    // A bid at INT64_MAX must not overflow the price walk
+    OrderBook top;
+    top.startAuction();
+    top.placeLimit(5, 100, false);                          // sell id 0
+    top.placeLimit(5, numeric_limits<price>::max(), true);  // buy id 1
+    assert(top.indicative() == (tuple<price, int64_t> {100, 5}));
+    assert(top.uncross() == Status::BOOK_EMPTY);
+    assert(top.getTrades().size() == 1 && top.getTrades()[0].price == 100);
+}
+
+// Primary pegs follow their own side's best price, queue behind lit orders at that
+// price and never show in the lit book.
+static void test_primary_peg() {
+    OrderBook ob;
+
+    ob.placeLimit(10, 100, true);           // buy id 0
+    ob.placeLimit(10, 110, false);          // sell id 1
+    ob.placeLimit(1, 90, true);             // buy id 2
+    ob.placePeg(5, true, Peg::PRIMARY);     // buy peg id 3
+    assert(ob.pegPrice(true, Peg::PRIMARY) == 100);
+    assert(ob.volume(100) == 10);
+
+    ob.placeLimit(3, 105, true);            // buy id 4 moves the peg up
+    assert(ob.pegPrice(true, Peg::PRIMARY) == 105);
+
+    ob.placeMarket(3, false);               // id 5 takes the lit 105 ahead of the peg
+    ob.placeMarket(12, false);              // id 6: lit 100 first, then the peg still at 100
+    auto trades = ob.getTrades();
+    assert(trades.size() == 3);
+    assert(trades[0].buyerID == 4 && trades[0].price == 105 && trades[0].quantity == 3);
+    assert(trades[1].buyerID == 0 && trades[1].price == 100 && trades[1].quantity == 10);
+    assert(trades[2].buyerID == 3 && trades[2].price == 100 && trades[2].quantity == 2);
+
+    assert(ob.pegPrice(true, Peg::PRIMARY) == 90);
+    Status st = ob.cancelOrder(3);
+    assert(st == Status::OK);
+    st = ob.cancelOrder(3);
+    assert(st == Status::ORDER_INACTIVE);
+    (void)st;
+
+    check_invariants(ob);
+}
+
+// Midpoint pegs trade inside the spread, reprice only when needed and cross each
+// other lazily once the mid lands on a tick.
+static void test_midpoint_peg() {
+    OrderBook ob;
+
+    ob.placeLimit(10, 100, true);           // buy id 0
+    ob.placeLimit(10, 101, false);          // sell id 1
+    ob.placeLimit(10, 102, false);          // sell id 2
+    ob.placePeg(4, true, Peg::MIDPOINT);    // buy peg id 3 at floor(100.5)
+    ob.placePeg(4, false, Peg::MIDPOINT);   // sell peg id 4 at ceil(100.5)
+    assert(ob.pegPrice(true, Peg::MIDPOINT) == 100);
+    assert(ob.pegPrice(false, Peg::MIDPOINT) == 101);
+    assert(ob.getTrades().empty());
+
+    ob.cancelOrder(1);                      // mid is now 101 on both sides
+    assert(ob.getTrades().empty());         // nothing happens until the book is touched
+
+    ob.placeLimit(1, 90, true);             // id 5, non-marketable, triggers the cross
+    auto trades = ob.getTrades();
+    assert(trades.size() == 1);
+    assert(trades[0].buyerID == 3 && trades[0].sellerID == 4 && trades[0].price == 101 && trades[0].quantity == 4);
+
+    ob.placePeg(6, false, Peg::MIDPOINT);   // sell peg id 6 at 101, ahead of the lit 102
+    ob.placeLimit(8, 102, true);            // buy id 7: 6 from the peg at 101, 2 lit at 102
+    trades = ob.getTrades();
+    assert(trades.size() == 3);
+    assert(trades[1].sellerID == 6 && trades[1].price == 101 && trades[1].quantity == 6);
+    assert(trades[2].sellerID == 2 && trades[2].price == 102 && trades[2].quantity == 2);
+
+    check_invariants(ob);
+}
+
+// Pegs cannot be entered during an auction, so modifying one there must be rejected
+// without cancelling it.
+static void test_peg_modify_in_auction() {
+    OrderBook ob;
+
+    ob.placeLimit(10, 100, true);           // buy id 0
+    ob.placeLimit(10, 102, false);          // sell id 1
+    ob.placePeg(5, true, Peg::PRIMARY);     // buy peg id 2
+    ob.startAuction();
+
+    assert(ob.modifyOrder(2, 0, 7) == Status::INVALID_PHASE);
+    assert(ob.modifyOrder(2, 0, 0) == Status::INVALID_QTY);
+    assert(get<0>(ob.liquidity()) == 15);   // the peg is still resting
+    assert(ob.cancelOrder(2) == Status::OK);
+    assert(get<0>(ob.liquidity()) == 10);
+
+    check_invariants(ob);
+}
+
+// The midpoint of two prices near INT64_MAX / 2 must not overflow.
+static void test_midpoint_peg_large_prices() {
+    const price half = numeric_limits<price>::max() / 2;
+    OrderBook ob;
+
+    ob.placeLimit(10, half + 6, true);      // buy id 0
+    ob.placeLimit(10, half + 10, false);    // sell id 1
+    assert(ob.pegPrice(true, Peg::MIDPOINT) == half + 8);
+    assert(ob.pegPrice(false, Peg::MIDPOINT) == half + 8);
+
+    ob.placeLimit(10, half + 7, false);     // sell id 2, mid half + 6.5
+    assert(ob.pegPrice(true, Peg::MIDPOINT) == half + 6);
+    assert(ob.pegPrice(false, Peg::MIDPOINT) == half + 7);
+
+    ob.placePeg(4, false, Peg::MIDPOINT);   // sell peg id 3 rests at half + 7, above the bid
+    assert(ob.getTrades().empty());
+
+    check_invariants(ob);
+}
+
+// Lit-only flow must trade exactly as the original rest-then-match engine did (at the
+// resting order's price, FIFO within a level). Expected values were recorded from that engine.
+static void test_lit_matches_rest_then_match() {
+    OrderBook ob;
+
+    Status st[] = {
+        ob.placeLimit(5, 100, true),        // buy id 0
+        ob.placeLimit(5, 100, true),        // buy id 1
+        ob.placeLimit(3, 99, true),         // buy id 2
+        ob.placeLimit(4, 102, false),       // sell id 3
+        ob.placeLimit(6, 103, false),       // sell id 4
+        ob.placeLimit(12, 99, false),       // sell id 5 sweeps 100 (FIFO) and part of 99
+        ob.placeLimit(7, 103, true),        // buy id 6 sweeps 102 and part of 103
+        ob.placeLimit(10, 104, true),       // buy id 7 takes the rest of 103, rests 7
+        ob.placeLimit(2, 104, false),       // sell id 8 hits the resting buy
+        ob.placeLimit(4, 105, false)        // sell id 9 rests
+    };
+    const Status expected[] = {
+        Status::BOOK_EMPTY, Status::BOOK_EMPTY, Status::BOOK_EMPTY, Status::OK, Status::OK,
+        Status::OK, Status::OK, Status::BOOK_EMPTY, Status::BOOK_EMPTY, Status::OK
+    };
+    for (int i = 0; i < 10; i++) assert(st[i] == expected[i]);
+
+    // buyer, seller, price, quantity
+    const tuple<id, id, price, qty> fills[] = {
+        {0, 5, 100, 5}, {1, 5, 100, 5}, {2, 5, 99, 2}, {6, 3, 102, 4},
+        {6, 4, 103, 3}, {7, 4, 103, 3}, {7, 8, 104, 2}
+    };
+    auto trades = ob.getTrades();
+    assert(trades.size() == 7);
+    for (size_t i = 0; i < trades.size(); i++) {
+        assert(tuple(trades[i].buyerID, trades[i].sellerID, trades[i].price, trades[i].quantity) == fills[i]);
+    }
+
+    // id, quantity, price
+    const tuple<id, qty, price> resting[] = {{2, 1, 99}, {7, 5, 104}, {9, 4, 105}};
+    auto book = ob.getBook();
+    assert(book.size() == 3);
+    for (size_t i = 0; i < book.size(); i++) {
+        assert(tuple(book[i].orderID, book[i].quantity, book[i].price) == resting[i]);
+    }
+
+    check_invariants(ob);
+}
+
+// Icebergs show one slice at a time; a filled slice comes back from the reserve at
+// the back of its level under the same ID.
+static void test_iceberg_replenish() {
+    OrderBook ob;
+
+    Status st = ob.placeIceberg(10, 20, 100, false);
+    assert(st == Status::INVALID_QTY);      // peak above total, no id used
+
+    ob.placeIceberg(50, 10, 100, false);    // sell id 0: 10 shown, 40 in reserve
+    ob.placeLimit(5, 100, false);           // sell id 1
+    assert(ob.volume(100) == 15);
+    assert(ob.executable(100) == 55);
+    assert(get<1>(ob.size()) == 15);
+    assert(get<1>(ob.liquidity()) == 55);
+
+    ob.placeLimit(12, 100, true);           // buy id 2: slice of id 0, then id 1 (id 0 went to the back)
+    auto trades = ob.getTrades();
+    assert(trades.size() == 2);
+    assert(trades[0].sellerID == 0 && trades[0].quantity == 10);
+    assert(trades[1].sellerID == 1 && trades[1].quantity == 2);
+
+    auto book = ob.getBook();
+    assert(book.size() == 2);
+    assert(book[0].orderID == 1 && book[0].quantity == 3);
+    assert(book[1].orderID == 0 && book[1].quantity == 10 && book[1].reserve == 0);  // reserve stays hidden
+    assert(ob.executable(100) == 43);
+
+    st = ob.placeMarket(100, true);         // id 3 takes id 1 then every remaining slice
+    assert(st == Status::PARTIAL_FILL);
+    trades = ob.getTrades();
+    assert(trades.size() == 7);
+    for (size_t i = 3; i < trades.size(); i++) assert(trades[i].sellerID == 0 && trades[i].quantity == 10);
+    assert(ob.bestAsk() == -1);
+
+    st = ob.cancelOrder(0);
+    assert(st == Status::ORDER_INACTIVE);
+
+    // Reserves count towards the auction equilibrium
+    ob.startAuction();
+    ob.placeIceberg(30, 5, 100, false);     // sell id 4
+    ob.placeLimit(20, 101, true);           // buy id 5
+    assert(ob.indicative() == make_tuple(price(100), int64_t(20)));
+    st = ob.uncross();
+    assert(st == Status::BOOK_EMPTY);
+    (void)st;
+    assert(ob.volume(100) == 5);
+    assert(ob.executable(100) == 10);
+
+    check_invariants(ob);
+}
+
 // Randomized “fuzz” test: throws lots of ops at your book and checks invariants.
 // This catches crashes, crossed book states, negative sizes, etc.
 static void test_fuzz_invariants() {
@@ -162,6 +505,16 @@ int main() {
     test_fifo_at_same_price();
     test_cancel_and_inactive();
     test_modify_order_basic();
+    test_hybrid_levels_migrate();
+    test_hybrid_levels_extreme_prices();
+    test_protocol_decode();
+    test_auction_uncross();
+    test_primary_peg();
+    test_midpoint_peg();
+    test_peg_modify_in_auction();
+    test_midpoint_peg_large_prices();
+    test_lit_matches_rest_then_match();
+    test_iceberg_replenish();
     test_fuzz_invariants();
 
     std::cout << "All OrderBook tests passed.\n";